@@ -0,0 +1,83 @@
+/**
+ * @file phybatch.c
+ * @brief C file containing the batch shot evaluation workload used to compare library precisions.
+ *
+ * Every shot starts from the same layout and is simulated until all balls stop. The file is
+ * built twice, so the function names carry the precision of the build.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <time.h>
+
+#include "phylib.h"
+#include "phybatch.h"
+
+#ifdef PHYLIB_SINGLE
+#define PHYBATCH(name) name##_float
+#else
+#define PHYBATCH(name) name##_double
+#endif
+
+/**
+ * Simulates a batch of shots from one layout and records where every ball ends up.
+ *
+ * @param balls      The x,y positions of balls 0 to ball_count-1, ball 0 being the cue ball.
+ * @param ball_count The number of balls.
+ * @param shots      The x,y cue ball velocities of each shot.
+ * @param shot_count The number of shots.
+ * @param final      Receives the x,y final position of every ball for every shot, NAN if pocketed.
+ * @param pocketed   Receives a bit mask of the balls pocketed by every shot.
+ * @return           The wall clock time spent simulating, in seconds.
+ */
+double PHYBATCH(phybatch_run)(const double *balls, int ball_count, const double *shots, int shot_count,
+                              double *final, unsigned int *pocketed) {
+
+    phylib_table *table = phylib_new_table();
+    if (table == NULL) {
+        return -1.0;
+    }
+    for (int n = 0; n < ball_count; n++) {
+        phylib_coord pos = { (phylib_real)balls[2 * n], (phylib_real)balls[2 * n + 1] };
+        phylib_add_object(table, phylib_new_still_ball((unsigned char)n, &pos));
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    for (int s = 0; s < shot_count; s++) {
+        phylib_table *shot = phylib_copy_table(table);
+        phylib_coord vel = { (phylib_real)shots[2 * s], (phylib_real)shots[2 * s + 1] };
+        phylib_strike(shot, 0, &vel);
+
+        phylib_stop stop;
+        memset(&stop, 0, sizeof(stop));
+        phylib_table *result = phylib_simulate(shot, &stop);
+        pocketed[s] = stop.pocketed;
+
+        // balls keep their table slot, 10 + number, for the whole shot
+        for (int n = 0; n < ball_count; n++) {
+            phylib_object *ball = result ? result->object[10 + n] : NULL;
+            final[2 * (s * ball_count + n)] = ball ? ball->obj.still_ball.pos.x : NAN;
+            final[2 * (s * ball_count + n) + 1] = ball ? ball->obj.still_ball.pos.y : NAN;
+        }
+
+        phylib_free_table(result);
+        phylib_free_table(shot);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    phylib_free_table(table);
+    return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+}
+
+/**
+ * Returns the memory taken by one stored table snapshot with the given number of balls.
+ *
+ * @param ball_count The number of balls on the table.
+ * @return           The size in bytes of the table and all its objects.
+ */
+size_t PHYBATCH(phybatch_snapshot)(int ball_count) {
+
+    return sizeof(phylib_table) + (size_t)(10 + ball_count) * sizeof(phylib_object);
+}
@@ -0,0 +1,24 @@
+/**
+ * @file phybatch.h
+ * @brief Header file for the batch shot evaluation workload used to compare library precisions.
+ *
+ * phybatch.c is compiled once against the double library and once with PHYLIB_SINGLE against
+ * the float one. Both variants exchange data as plain doubles so one program can call both.
+ */
+
+#ifndef PHYBATCH_H
+#define PHYBATCH_H
+
+#include <stddef.h>
+
+double phybatch_run_double( const double *balls, int ball_count, const double *shots, int shot_count,
+                            double *final, unsigned int *pocketed );
+
+double phybatch_run_float( const double *balls, int ball_count, const double *shots, int shot_count,
+                           double *final, unsigned int *pocketed );
+
+size_t phybatch_snapshot_double( int ball_count );
+
+size_t phybatch_snapshot_float( int ball_count );
+
+#endif
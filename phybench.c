@@ -0,0 +1,430 @@
+/**
+ * @file phybench.c
+ * @brief Benchmarks for the billiards physics simulation library.
+ *
+ * Each mode builds reproducible random layouts and reports how much work the library does.
+ *
+ * Usage: phybench solve|stop|precision|spin [count]
+ *   solve  compares phylib_solve_pocket with uniform sampling of cue velocities and reports
+ *          the number of simulated shots needed per answer.
+ *   stop   compares simulating shots until every ball stops with stopping on each predicate.
+ *   precision  runs the batch shot workload against the double and float libraries and reports
+ *          throughput, snapshot footprint and how far the float results drift.
+ *   spin   runs the same shots on tables without spin and with spin, with and without a cue
+ *          tip offset, and reports the cost per shot and per segment of each model.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <time.h>
+
+#include "phylib.h"
+#include "phybatch.h"
+
+#define PHYBENCH_ANGLES (72)
+#define PHYBENCH_SPEEDS (8)
+#define PHYBENCH_MIN_SPEED (500.0) // mm/s
+#define PHYBENCH_MAX_SPEED (4000.0) // mm/s
+
+/**
+ * Returns a monotonic timestamp in seconds.
+ *
+ * @return The current time.
+ */
+static double phybench_now(void) {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Returns a uniformly distributed random number.
+ *
+ * @param lo The lower bound.
+ * @param hi The upper bound.
+ * @return   A number between lo and hi.
+ */
+static double phybench_uniform(double lo, double hi) {
+
+    return lo + (hi - lo) * ((double)rand() / RAND_MAX);
+}
+
+/**
+ * Creates a table with balls 0 to count-1 at random, non-overlapping positions away from the holes.
+ *
+ * @param count The number of balls to place, including the cue ball.
+ * @return      A pointer to the new table, or NULL if memory allocation fails.
+ */
+static phylib_table *phybench_layout(int count) {
+
+    phylib_table *table = phylib_new_table();
+    if (table == NULL) {
+        return NULL;
+    }
+
+    phylib_coord placed[PHYLIB_MAX_OBJECTS];
+    for (int n = 0; n < count; n++) {
+        phylib_coord pos;
+        int clear;
+        do {
+            pos.x = phybench_uniform(PHYLIB_HOLE_RADIUS, PHYLIB_TABLE_WIDTH - PHYLIB_HOLE_RADIUS);
+            pos.y = phybench_uniform(PHYLIB_HOLE_RADIUS, PHYLIB_TABLE_LENGTH - PHYLIB_HOLE_RADIUS);
+            clear = 1;
+            for (int k = 0; k < n; k++) {
+                if (phylib_length(phylib_sub(pos, placed[k])) < 2.0 * PHYLIB_BALL_DIAMETER) {
+                    clear = 0;
+                }
+            }
+            // the middle holes reach into the table
+            if (pos.y > PHYLIB_TABLE_WIDTH - PHYLIB_HOLE_RADIUS - PHYLIB_BALL_DIAMETER
+            && pos.y < PHYLIB_TABLE_WIDTH + PHYLIB_HOLE_RADIUS + PHYLIB_BALL_DIAMETER
+            && (pos.x < PHYLIB_HOLE_RADIUS + PHYLIB_BALL_DIAMETER || pos.x > PHYLIB_TABLE_WIDTH - PHYLIB_HOLE_RADIUS - PHYLIB_BALL_DIAMETER)) {
+                clear = 0;
+            }
+        } while (!clear);
+
+        placed[n] = pos;
+        phylib_add_object(table, phylib_new_still_ball((unsigned char)n, &pos));
+    }
+
+    return table;
+}
+
+/**
+ * Samples cue velocities on a fixed grid, in a shuffled order, until one pockets the target.
+ *
+ * @param table       A pointer to the table.
+ * @param target      The number of the ball to pocket.
+ * @param simulations A pointer receiving the number of simulated shots.
+ * @return            1 if a pocketing shot was found, otherwise 0.
+ */
+static int phybench_uniform_search(phylib_table *table, unsigned char target, int *simulations) {
+
+    int total = PHYBENCH_ANGLES * PHYBENCH_SPEEDS;
+    int order[PHYBENCH_ANGLES * PHYBENCH_SPEEDS];
+    for (int i = 0; i < total; i++) {
+        order[i] = i;
+    }
+    for (int i = total - 1; i > 0; i--) {
+        int j = rand() % (i + 1);
+        int swap = order[i];
+        order[i] = order[j];
+        order[j] = swap;
+    }
+
+    *simulations = 0;
+    for (int i = 0; i < total; i++) {
+        double angle = (order[i] % PHYBENCH_ANGLES) * (2.0 * 3.14159265358979323846 / PHYBENCH_ANGLES);
+        double speed = PHYBENCH_MIN_SPEED
+            + (order[i] / PHYBENCH_ANGLES) * ((PHYBENCH_MAX_SPEED - PHYBENCH_MIN_SPEED) / (PHYBENCH_SPEEDS - 1));
+        phylib_coord vel = { speed * cos(angle), speed * sin(angle) };
+
+        (*simulations)++;
+        if (phylib_try_pocket(table, target, &vel, NULL) == 1) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Runs the solver benchmark.
+ *
+ * @param layouts The number of random layouts to solve.
+ */
+static void phybench_solve(int layouts) {
+
+    int solver_answers = 0;
+    int uniform_answers = 0;
+    long solver_sims = 0;
+    long uniform_sims = 0;
+    double solver_time = 0.0;
+    double uniform_time = 0.0;
+
+    for (int l = 0; l < layouts; l++) {
+        phylib_table *table = phybench_layout(6);
+        phylib_shot shots[6];
+        int simulations;
+
+        double start = phybench_now();
+        int found = phylib_solve_pocket(table, 1, NULL, 0, shots, 6, &simulations);
+        solver_time += phybench_now() - start;
+        solver_sims += simulations;
+        if (found > 0) {
+            solver_answers++;
+        }
+
+        start = phybench_now();
+        if (phybench_uniform_search(table, 1, &simulations)) {
+            uniform_answers++;
+        }
+        uniform_time += phybench_now() - start;
+        uniform_sims += simulations;
+
+        phylib_free_table(table);
+    }
+
+    printf("solve: %d layouts, 6 balls each, target ball 1\n", layouts);
+    printf("  %-8s %8s %12s %14s %12s\n", "method", "answers", "simulations", "sims/answer", "s/answer");
+    printf("  %-8s %8d %12ld %14.1f %12.4f\n", "solver", solver_answers, solver_sims,
+        solver_answers ? (double)solver_sims / solver_answers : 0.0,
+        solver_answers ? solver_time / solver_answers : 0.0);
+    printf("  %-8s %8d %12ld %14.1f %12.4f\n", "uniform", uniform_answers, uniform_sims,
+        uniform_answers ? (double)uniform_sims / uniform_answers : 0.0,
+        uniform_answers ? uniform_time / uniform_answers : 0.0);
+}
+
+/**
+ * Runs the stop predicate benchmark.
+ *
+ * @param layouts The number of random layouts to shoot on.
+ */
+static void phybench_stop(int layouts) {
+
+    static const struct {
+        const char *name;
+        unsigned int predicates;
+    } cases[] = {
+        { "all stopped", 0 },
+        { "first contact", PHYLIB_STOP_FIRST_CONTACT },
+        { "ball 1 pocketed", PHYLIB_STOP_BALL_POCKETED },
+        { "cue pocketed", PHYLIB_STOP_CUE_POCKETED },
+        { "any pocketed", PHYLIB_STOP_ANY_POCKETED },
+        { "time 1 s", PHYLIB_STOP_TIME },
+    };
+    int count = (int)(sizeof(cases) / sizeof(cases[0]));
+    double times[sizeof(cases) / sizeof(cases[0])] = { 0.0 };
+    int fired[sizeof(cases) / sizeof(cases[0])] = { 0 };
+    int mismatches = 0;
+
+    for (int l = 0; l < layouts; l++) {
+        phylib_table *table = phybench_layout(6);
+
+        // aim roughly at ball 1 so most shots make contact
+        phylib_coord cue = table->object[10]->obj.still_ball.pos;
+        phylib_coord target = table->object[11]->obj.still_ball.pos;
+        phylib_coord dir = phylib_sub(target, cue);
+        double angle = atan2(dir.y, dir.x) + phybench_uniform(-0.05, 0.05);
+        double speed = phybench_uniform(1000.0, 3000.0);
+        phylib_coord vel = { speed * cos(angle), speed * sin(angle) };
+        phylib_strike(table, 0, &vel);
+
+        int full_contact = -1;
+        for (int c = 0; c < count; c++) {
+            phylib_stop stop;
+            memset(&stop, 0, sizeof(stop));
+            stop.predicates = cases[c].predicates;
+            stop.ball = 1;
+            stop.time = 1.0;
+
+            double start = phybench_now();
+            phylib_table *result = phylib_simulate(table, &stop);
+            times[c] += phybench_now() - start;
+            if (stop.fired != 0) {
+                fired[c]++;
+            }
+
+            // stopping early must not change the answer
+            if (c == 0) {
+                full_contact = stop.first_contact;
+            } else if (cases[c].predicates == PHYLIB_STOP_FIRST_CONTACT && stop.first_contact != full_contact) {
+                mismatches++;
+            }
+            phylib_free_table(result);
+        }
+
+        phylib_free_table(table);
+    }
+
+    printf("stop: %d layouts, 6 balls each, cue aimed near ball 1\n", layouts);
+    printf("  %-16s %8s %12s %10s\n", "predicate", "fired", "ms/shot", "speedup");
+    for (int c = 0; c < count; c++) {
+        printf("  %-16s %8d %12.3f %9.1fx\n", cases[c].name, fired[c],
+            times[c] * 1000.0 / layouts, times[c] > 0.0 ? times[0] / times[c] : 0.0);
+    }
+    printf("  first contact mismatches against the full simulation: %d\n", mismatches);
+}
+
+/**
+ * Comparison function used to sort errors.
+ */
+static int phybench_compare(const void *a, const void *b) {
+
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Runs one batch in both precisions and prints a line comparing them.
+ *
+ * @param label      The name of the workload.
+ * @param ball_count The number of balls, including the cue ball.
+ * @param shot_count The number of shots in the batch.
+ */
+static void phybench_precision_case(const char *label, int ball_count, int shot_count) {
+
+    phylib_table *table = phybench_layout(ball_count);
+    double *balls = (double *)malloc(sizeof(double) * 2 * ball_count);
+    double *shots = (double *)malloc(sizeof(double) * 2 * shot_count);
+    double *final_d = (double *)malloc(sizeof(double) * 2 * ball_count * shot_count);
+    double *final_f = (double *)malloc(sizeof(double) * 2 * ball_count * shot_count);
+    double *errors = (double *)malloc(sizeof(double) * ball_count * shot_count);
+    unsigned int *pocketed_d = (unsigned int *)malloc(sizeof(unsigned int) * shot_count);
+    unsigned int *pocketed_f = (unsigned int *)malloc(sizeof(unsigned int) * shot_count);
+
+    for (int n = 0; n < ball_count; n++) {
+        balls[2 * n] = table->object[10 + n]->obj.still_ball.pos.x;
+        balls[2 * n + 1] = table->object[10 + n]->obj.still_ball.pos.y;
+    }
+    for (int s = 0; s < shot_count; s++) {
+        double angle = phybench_uniform(0.0, 2.0 * 3.14159265358979323846);
+        double speed = phybench_uniform(500.0, 2500.0);
+        shots[2 * s] = speed * cos(angle);
+        shots[2 * s + 1] = speed * sin(angle);
+    }
+
+    double time_d = phybatch_run_double(balls, ball_count, shots, shot_count, final_d, pocketed_d);
+    double time_f = phybatch_run_float(balls, ball_count, shots, shot_count, final_f, pocketed_f);
+
+    // position errors over balls left on the table in both runs
+    int agree = 0;
+    int count = 0;
+    for (int s = 0; s < shot_count; s++) {
+        agree += pocketed_d[s] == pocketed_f[s];
+        for (int n = 0; n < ball_count; n++) {
+            int k = 2 * (s * ball_count + n);
+            if (!isnan(final_d[k]) && !isnan(final_f[k])) {
+                errors[count++] = hypot(final_d[k] - final_f[k], final_d[k + 1] - final_f[k + 1]);
+            }
+        }
+    }
+    qsort(errors, (size_t)count, sizeof(double), phybench_compare);
+
+    printf("  %-10s %9.1f %9.1f %7lu %7lu %7.1f%% %10.4f %10.4f %10.4f\n", label,
+        shot_count / time_d, shot_count / time_f,
+        (unsigned long)phybatch_snapshot_double(ball_count), (unsigned long)phybatch_snapshot_float(ball_count),
+        100.0 * agree / shot_count,
+        count ? errors[count / 2] : 0.0, count ? errors[(int)(count * 0.95)] : 0.0, count ? errors[count - 1] : 0.0);
+
+    free(balls);
+    free(shots);
+    free(final_d);
+    free(final_f);
+    free(errors);
+    free(pocketed_d);
+    free(pocketed_f);
+    phylib_free_table(table);
+}
+
+/**
+ * Runs the precision benchmark.
+ *
+ * @param shot_count The number of shots per batch.
+ */
+static void phybench_precision(int shot_count) {
+
+    printf("precision: %d shots per batch, 500-2500 mm/s in random directions\n", shot_count);
+    printf("  %-10s %9s %9s %7s %7s %8s %10s %10s %10s\n", "workload", "double/s", "float/s",
+        "B(dbl)", "B(flt)", "pockets", "err p50", "err p95", "err max");
+    phybench_precision_case("cue only", 1, shot_count);
+    phybench_precision_case("6 balls", 6, shot_count);
+    phybench_precision_case("16 balls", 16, shot_count);
+    printf("  B = bytes per table snapshot, pockets = shots with the same balls pocketed, err in mm\n");
+}
+
+/**
+ * Runs the spin benchmark: the same shots on tables without spin, with spin but a centre hit,
+ * and with spin from a random cue tip offset.
+ *
+ * @param layouts The number of random layouts to shoot on.
+ */
+static void phybench_spin(int layouts) {
+
+    static const char *names[] = { "rolling only", "spin, centre", "spin, random tip" };
+    double times[3] = { 0.0 };
+    long segments[3] = { 0 };
+    double simulated[3] = { 0.0 };
+    int pocketed[3] = { 0 };
+
+    for (int l = 0; l < layouts; l++) {
+        phylib_table *layout = phybench_layout(6);
+
+        // aim roughly at ball 1 so most shots make contact
+        phylib_coord cue = layout->object[10]->obj.still_ball.pos;
+        phylib_coord target = layout->object[11]->obj.still_ball.pos;
+        phylib_coord dir = phylib_sub(target, cue);
+        double angle = atan2(dir.y, dir.x) + phybench_uniform(-0.05, 0.05);
+        double speed = phybench_uniform(1000.0, 3000.0);
+        phylib_coord vel = { speed * cos(angle), speed * sin(angle) };
+        double side = phybench_uniform(-0.4, 0.4);
+        double height = phybench_uniform(-0.4, 0.4);
+
+        for (int c = 0; c < 3; c++) {
+            phylib_table *table = phylib_copy_table(layout);
+            if (c == 0) {
+                phylib_strike(table, 0, &vel);
+            } else {
+                phylib_strike_spin(table, 0, &vel, c == 1 ? 0.0 : side, c == 1 ? 0.0 : height);
+            }
+
+            double start = phybench_now();
+            phylib_table *next;
+            while ((next = phylib_segment(table)) != NULL) {
+                phylib_free_table(table);
+                table = next;
+                segments[c]++;
+            }
+            times[c] += phybench_now() - start;
+            simulated[c] += table->time;
+
+            pocketed[c] += 6;
+            for (int i = 10; i < PHYLIB_MAX_OBJECTS; i++) {
+                pocketed[c] -= table->object[i] != NULL;
+            }
+            phylib_free_table(table);
+        }
+
+        phylib_free_table(layout);
+    }
+
+    printf("spin: %d layouts, 6 balls each, cue aimed near ball 1 at 1000-3000 mm/s\n", layouts);
+    printf("  %-16s %10s %10s %14s %10s %10s\n", "model", "ms/shot", "s/shot", "segments/shot", "us/step", "pocketed");
+    for (int c = 0; c < 3; c++) {
+        // every step advances the table by PHYLIB_SIM_RATE, so this is the cost of one step
+        printf("  %-16s %10.3f %10.2f %14.1f %10.3f %10.2f\n", names[c], times[c] * 1000.0 / layouts,
+            simulated[c] / layouts, (double)segments[c] / layouts,
+            simulated[c] > 0.0 ? times[c] * 1e6 * PHYLIB_SIM_RATE / simulated[c] : 0.0,
+            (double)pocketed[c] / layouts);
+    }
+    printf("  s/shot = simulated seconds until every ball stopped\n");
+}
+
+int main(int argc, char **argv) {
+
+    srand(2750);
+
+    if (argc > 1 && strcmp(argv[1], "solve") == 0) {
+        phybench_solve(argc > 2 ? atoi(argv[2]) : 20);
+        return 0;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "stop") == 0) {
+        phybench_stop(argc > 2 ? atoi(argv[2]) : 20);
+        return 0;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "precision") == 0) {
+        phybench_precision(argc > 2 ? atoi(argv[2]) : 50);
+        return 0;
+    }
+
+    if (argc > 1 && strcmp(argv[1], "spin") == 0) {
+        phybench_spin(argc > 2 ? atoi(argv[2]) : 20);
+        return 0;
+    }
+
+    fprintf(stderr, "usage: %s solve|stop|precision|spin [count]\n", argv[0]);
+    return 1;
+}
@@ -0,0 +1,497 @@
+/**
+ * @file phygame.c
+ * @brief C file containing the native eight-ball rules layer built on the physics library.
+ *
+ * A game racks fifteen balls, asks the shot policy of the player to move for a shot, simulates
+ * it to rest and then applies the rules: open table and group assignment, fouls (scratch, no
+ * contact, wrong ball first), ball in hand, turn changes and the eight ball ending the game.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <time.h>
+
+#include "phygame.h"
+
+#define PHYGAME_SOLIDS_MASK (0x00FEu) // balls 1 to 7
+#define PHYGAME_STRIPES_MASK (0xFE00u) // balls 9 to 15
+#define PHYGAME_EIGHT_MASK (0x0100u)
+
+// rack order from the apex row by row, with the eight ball in the middle of the third row
+static const unsigned char phygame_rack_order[15] = { 1, 9, 2, 10, 8, 3, 11, 4, 12, 5, 13, 6, 14, 7, 15 };
+
+/**
+ * Returns a monotonic timestamp in seconds.
+ *
+ * @return The current time.
+ */
+static double phygame_now(void) {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Returns the next number from the game's own random generator, so games on different
+ * threads never share state.
+ *
+ * @param game A pointer to the game.
+ * @return     A number in [0, 1).
+ */
+double phygame_random(phygame *game) {
+
+    // xorshift32
+    unsigned int x = game->seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    game->seed = x;
+    return (x & 0xFFFFFFu) / (double)0x1000000u;
+}
+
+/**
+ * Returns the mask of object balls belonging to a group.
+ *
+ * @param group The group.
+ * @return      The bit mask of its balls, or 0 for an open table.
+ */
+static unsigned int phygame_mask(phygame_group group) {
+
+    if (group == PHYGAME_SOLIDS) {
+        return PHYGAME_SOLIDS_MASK;
+    }
+    if (group == PHYGAME_STRIPES) {
+        return PHYGAME_STRIPES_MASK;
+    }
+    return 0;
+}
+
+/**
+ * Checks whether the player to move has pocketed every ball of their group.
+ *
+ * @param game A pointer to the game.
+ * @return     1 if the eight ball is the player's target, otherwise 0.
+ */
+static int phygame_cleared(phygame *game) {
+
+    unsigned int mask = phygame_mask(game->group[game->turn]);
+    return mask != 0 && (game->pocketed & mask) == mask;
+}
+
+/**
+ * Checks whether a ball may legally be hit first by the player to move.
+ *
+ * @param game   A pointer to the game.
+ * @param number The number of the object ball.
+ * @return       1 if the ball is a legal first contact, otherwise 0.
+ */
+int phygame_legal_target(phygame *game, unsigned char number) {
+
+    if (number == 0 || number > 15) {
+        return 0;
+    }
+    if (number == 8) {
+        return phygame_cleared(game);
+    }
+    if (game->group[game->turn] == PHYGAME_OPEN) {
+        return 1;
+    }
+    return (phygame_mask(game->group[game->turn]) & (1u << number)) != 0;
+}
+
+/**
+ * Finds the cue ball on the table.
+ *
+ * @param table A pointer to the table.
+ * @return      A pointer to the cue ball, or NULL if it was pocketed.
+ */
+static phylib_object *phygame_cue(phylib_table *table) {
+
+    for (int i = 10; i < PHYLIB_MAX_OBJECTS; i++) {
+        phylib_object *object = table->object[i];
+        if (object != NULL && object->type == PHYLIB_STILL_BALL && object->obj.still_ball.number == 0) {
+            return object;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Checks whether a cue ball at pos would touch an object ball or sit over a hole.
+ *
+ * @param table A pointer to the table.
+ * @param pos   The proposed cue ball position.
+ * @return      1 if the position is free, otherwise 0.
+ */
+static int phygame_clear(phylib_table *table, phylib_coord pos) {
+
+    if (pos.x < PHYLIB_BALL_RADIUS || pos.x > PHYLIB_TABLE_WIDTH - PHYLIB_BALL_RADIUS
+    || pos.y < PHYLIB_BALL_RADIUS || pos.y > PHYLIB_TABLE_LENGTH - PHYLIB_BALL_RADIUS) {
+        return 0;
+    }
+
+    for (int i = 4; i < PHYLIB_MAX_OBJECTS; i++) {
+        phylib_object *object = table->object[i];
+        if (object == NULL) {
+            continue;
+        }
+        if (object->type == PHYLIB_HOLE
+        && phylib_length(phylib_sub(pos, object->obj.hole.pos)) < PHYLIB_HOLE_RADIUS) {
+            return 0;
+        }
+        if (object->type == PHYLIB_STILL_BALL && object->obj.still_ball.number != 0
+        && phylib_length(phylib_sub(pos, object->obj.still_ball.pos)) < PHYLIB_BALL_DIAMETER) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Puts the cue ball in hand at a position, or at the nearest free spot along the head string.
+ *
+ * @param game A pointer to the game.
+ * @param pos  A pointer to the requested position, or NULL for the head spot.
+ * @return     0 on success, or -1 if memory allocation fails.
+ */
+static int phygame_place_cue(phygame *game, phylib_coord *pos) {
+
+    phylib_coord spot = { PHYLIB_TABLE_WIDTH / 2.0, PHYLIB_TABLE_LENGTH - PHYLIB_TABLE_WIDTH / 2.0 };
+
+    if (pos == NULL || !phygame_clear(game->table, *pos)) {
+        // walk outwards from the head spot until the cue ball fits
+        for (int step = 0; step < 64; step++) {
+            phylib_coord tried = spot;
+            tried.x += ((step % 2) ? -1.0 : 1.0) * ((step + 1) / 2) * PHYLIB_BALL_DIAMETER;
+            tried.y -= (step / 16) * PHYLIB_BALL_DIAMETER;
+            if (phygame_clear(game->table, tried)) {
+                spot = tried;
+                break;
+            }
+        }
+        pos = &spot;
+    }
+
+    phylib_object *cue = phygame_cue(game->table);
+    if (cue != NULL) {
+        cue->obj.still_ball.pos = *pos;
+        return 0;
+    }
+
+    cue = phylib_new_still_ball(0, pos);
+    if (cue == NULL) {
+        return -1;
+    }
+    phylib_add_object(game->table, cue);
+    return 0;
+}
+
+/**
+ * Puts the eight ball back on the foot spot, or on the nearest free spot on the long string,
+ * looking towards the foot cushion first.
+ *
+ * @param table A pointer to the table.
+ * @return      0 on success, or -1 if memory allocation fails.
+ */
+static int phygame_spot_eight(phylib_table *table) {
+
+    phylib_coord foot = { PHYLIB_TABLE_WIDTH / 2.0, PHYLIB_TABLE_WIDTH / 2.0 };
+    phylib_object *cue = phygame_cue(table);
+    phylib_coord spot = foot;
+    int found = 0;
+
+    // phygame_clear ignores the cue ball, which the eight ball must not touch either
+    for (double y = foot.y; !found && y >= PHYLIB_BALL_RADIUS; y -= PHYLIB_BALL_RADIUS) {
+        spot.y = y;
+        found = phygame_clear(table, spot)
+            && (cue == NULL || phylib_length(phylib_sub(spot, cue->obj.still_ball.pos)) >= PHYLIB_BALL_DIAMETER);
+    }
+    for (double y = foot.y + PHYLIB_BALL_RADIUS; !found && y <= PHYLIB_TABLE_LENGTH - PHYLIB_BALL_RADIUS; y += PHYLIB_BALL_RADIUS) {
+        spot.y = y;
+        found = phygame_clear(table, spot)
+            && (cue == NULL || phylib_length(phylib_sub(spot, cue->obj.still_ball.pos)) >= PHYLIB_BALL_DIAMETER);
+    }
+    if (!found) {
+        spot = foot;
+    }
+
+    phylib_object *eight = phylib_new_still_ball(8, &spot);
+    if (eight == NULL) {
+        return -1;
+    }
+    phylib_add_object(table, eight);
+    return 0;
+}
+
+/**
+ * Creates a game with a full rack and the cue ball on the head spot.
+ *
+ * @param seed    The seed of the game's random generator, must not be 0.
+ * @param player1 The shot policy of the first player, who breaks.
+ * @param player2 The shot policy of the second player.
+ * @return        A pointer to the new game, or NULL if memory allocation fails.
+ */
+phygame *phygame_new(unsigned int seed, phygame_policy player1, phygame_policy player2) {
+
+    double start = phygame_now();
+
+    phygame *game = (phygame *)calloc(1, sizeof(phygame));
+    if (game == NULL) {
+        return NULL;
+    }
+
+    game->table = phylib_new_table();
+    if (game->table == NULL) {
+        free(game);
+        return NULL;
+    }
+
+    game->policy[0] = player1;
+    game->policy[1] = player2;
+    game->winner = -1;
+    game->seed = seed ? seed : 1;
+
+    // triangle pointing at the cue ball with its apex on the foot spot, nudged like server.py
+    double spacing = PHYLIB_BALL_DIAMETER + PHYGAME_RACK_GAP;
+    int k = 0;
+    for (int row = 0; row < 5; row++) {
+        for (int col = 0; col <= row; col++) {
+            phylib_coord pos;
+            pos.x = PHYLIB_TABLE_WIDTH / 2.0 + (col - row / 2.0) * spacing + phygame_random(game) - 0.5;
+            pos.y = PHYLIB_TABLE_WIDTH / 2.0 - row * sqrt(3.0) / 2.0 * spacing + phygame_random(game) - 0.5;
+            phylib_add_object(game->table, phylib_new_still_ball(phygame_rack_order[k++], &pos));
+        }
+    }
+
+    if (phygame_place_cue(game, NULL) != 0) {
+        phygame_free(game);
+        return NULL;
+    }
+
+    game->phase_time[PHYGAME_PHASE_RACK] += phygame_now() - start;
+    return game;
+}
+
+/**
+ * Frees a game and its table.
+ *
+ * @param game A pointer to the game, may be NULL.
+ */
+void phygame_free(phygame *game) {
+
+    if (game == NULL) {
+        return;
+    }
+    phylib_free_table(game->table);
+    free(game);
+}
+
+/**
+ * Applies the rules to the outcome of a shot.
+ *
+ * @param game A pointer to the game, still describing the state before the shot.
+ * @param stop A pointer to the stop request the shot was simulated with.
+ * @return     0 on success, or -1 if memory allocation fails.
+ */
+static int phygame_rules(phygame *game, phylib_stop *stop) {
+
+    unsigned int dropped = stop->pocketed & 0xFFFEu;
+    int scratch = (stop->pocketed & 1u) != 0;
+    int cleared = phygame_cleared(game);
+    int breaking = game->shots == 0;
+    int foul = scratch || stop->first_contact < 0 || !phygame_legal_target(game, (unsigned char)stop->first_contact);
+
+    game->shots++;
+    game->fouls += foul;
+
+    // the eight ball dropped on the break is spotted again, later it ends the game either way
+    if ((dropped & PHYGAME_EIGHT_MASK) && breaking) {
+        if (phygame_spot_eight(game->table) != 0) {
+            return -1;
+        }
+        dropped &= ~PHYGAME_EIGHT_MASK;
+    } else if (dropped & PHYGAME_EIGHT_MASK) {
+        game->winner = (!foul && cleared) ? game->turn : 1 - game->turn;
+        return 0;
+    }
+
+    game->pocketed |= dropped;
+
+    // the table stays open after the break; later the first legal pot chooses the group,
+    // ties go to the ball hit first
+    if (!breaking && game->group[game->turn] == PHYGAME_OPEN && !foul && dropped != 0) {
+        int solids = (dropped & PHYGAME_SOLIDS_MASK) != 0;
+        int stripes = (dropped & PHYGAME_STRIPES_MASK) != 0;
+        phygame_group group = solids && !stripes ? PHYGAME_SOLIDS
+            : stripes && !solids ? PHYGAME_STRIPES
+            : stop->first_contact < 8 ? PHYGAME_SOLIDS : PHYGAME_STRIPES;
+        game->group[game->turn] = group;
+        game->group[1 - game->turn] = group == PHYGAME_SOLIDS ? PHYGAME_STRIPES : PHYGAME_SOLIDS;
+    }
+
+    // a clean pot of an own ball, or of any ball on the break, keeps the table; anything else
+    // passes it, fouls with ball in hand
+    int own = breaking ? dropped != 0 : (dropped & phygame_mask(game->group[game->turn])) != 0;
+    game->ball_in_hand = foul;
+    if (foul || !own) {
+        game->turn = 1 - game->turn;
+    }
+
+    if (game->shots >= PHYGAME_MAX_SHOTS) {
+        game->winner = -2;
+    }
+    return 0;
+}
+
+/**
+ * Plays one shot of the game.
+ *
+ * @param game A pointer to the game.
+ * @return     1 if the game goes on, 0 if it is over, or -1 on error.
+ */
+int phygame_turn(phygame *game) {
+
+    if (game == NULL || game->winner != -1) {
+        return game == NULL ? -1 : 0;
+    }
+
+    double start = phygame_now();
+
+    // with ball in hand the cue ball starts on the head spot and the policy may move it
+    if (game->ball_in_hand && phygame_place_cue(game, NULL) != 0) {
+        return -1;
+    }
+
+    phygame_shot shot;
+    memset(&shot, 0, sizeof(shot));
+    game->policy[game->turn](game, &shot);
+
+    if (game->ball_in_hand && shot.place && phygame_place_cue(game, &shot.pos) != 0) {
+        return -1;
+    }
+    double decided = phygame_now();
+
+    // strike and simulate until every ball is at rest, each shot on a fresh clock since
+    // phylib stops simulating once a table reaches PHYLIB_MAX_TIME
+    game->table->time = 0.0;
+    if (phylib_strike(game->table, 0, &shot.vel) == NULL) {
+        return -1;
+    }
+    phylib_stop stop;
+    memset(&stop, 0, sizeof(stop));
+    phylib_table *result = phylib_simulate(game->table, &stop);
+    if (result == NULL) {
+        return -1;
+    }
+    phylib_free_table(game->table);
+    game->table = result;
+    double simulated = phygame_now();
+
+    if (phygame_rules(game, &stop) != 0) {
+        return -1;
+    }
+
+    // a scratched cue ball is gone from the table; the next turn has ball in hand
+    if (phygame_cue(game->table) == NULL && game->winner == -1) {
+        game->ball_in_hand = 1;
+    }
+    double ruled = phygame_now();
+
+    game->phase_time[PHYGAME_PHASE_POLICY] += decided - start;
+    game->phase_time[PHYGAME_PHASE_SIMULATE] += simulated - decided;
+    game->phase_time[PHYGAME_PHASE_RULES] += ruled - simulated;
+
+    return game->winner == -1;
+}
+
+/**
+ * Plays turns until the game is over.
+ *
+ * @param game A pointer to the game.
+ * @return     The winning player, -2 for a draw, or -1 on error.
+ */
+int phygame_play(phygame *game) {
+
+    int rc;
+    while ((rc = phygame_turn(game)) == 1) {
+    }
+    return rc < 0 ? -1 : game->winner;
+}
+
+/**
+ * Shot policy that hits the cue ball in a random direction at a random speed.
+ *
+ * @param game A pointer to the game.
+ * @param shot A pointer to the shot to fill in.
+ */
+void phygame_random_policy(phygame *game, phygame_shot *shot) {
+
+    double angle = phygame_random(game) * 2.0 * 3.14159265358979323846;
+    double speed = 500.0 + phygame_random(game) * 3500.0;
+    shot->vel.x = speed * cos(angle);
+    shot->vel.y = speed * sin(angle);
+}
+
+/**
+ * Shot policy that takes the pocketing shot with the largest margin on the nearest legal balls,
+ * breaks hard at the apex on the first shot, and otherwise plays a firm hit at the nearest legal ball.
+ *
+ * @param game A pointer to the game.
+ * @param shot A pointer to the shot to fill in.
+ */
+void phygame_greedy_policy(phygame *game, phygame_shot *shot) {
+
+    phylib_object *cue = phygame_cue(game->table);
+    if (cue == NULL) {
+        phygame_random_policy(game, shot);
+        return;
+    }
+    phylib_coord cue_pos = cue->obj.still_ball.pos;
+
+    // the two nearest legal object balls
+    int nearest[2] = { -1, -1 };
+    double dist[2] = { 0.0, 0.0 };
+    for (int i = 10; i < PHYLIB_MAX_OBJECTS; i++) {
+        phylib_object *object = game->table->object[i];
+        if (object == NULL || object->type != PHYLIB_STILL_BALL
+        || !phygame_legal_target(game, object->obj.still_ball.number)) {
+            continue;
+        }
+        double d = phylib_length(phylib_sub(object->obj.still_ball.pos, cue_pos));
+        if (nearest[0] < 0 || d < dist[0]) {
+            nearest[1] = nearest[0];
+            dist[1] = dist[0];
+            nearest[0] = i;
+            dist[0] = d;
+        } else if (nearest[1] < 0 || d < dist[1]) {
+            nearest[1] = i;
+            dist[1] = d;
+        }
+    }
+
+    if (nearest[0] < 0) {
+        phygame_random_policy(game, shot);
+        return;
+    }
+
+    phylib_coord aim = phylib_sub(game->table->object[nearest[0]]->obj.still_ball.pos, cue_pos);
+    double speed = game->shots == 0 ? PHYGAME_BREAK_SPEED : 2000.0;
+    shot->vel.x = aim.x / dist[0] * speed;
+    shot->vel.y = aim.y / dist[0] * speed;
+
+    // no pocketing attempt on the break, the rack blocks every ghost ball path anyway
+    if (game->shots == 0) {
+        return;
+    }
+
+    double best = -1.0;
+    for (int n = 0; n < 2 && nearest[n] >= 0; n++) {
+        phylib_shot shots[1];
+        unsigned char number = game->table->object[nearest[n]]->obj.still_ball.number;
+        if (phylib_solve_pocket(game->table, number, NULL, 0, shots, 1, NULL) > 0 && shots[0].margin > best) {
+            best = shots[0].margin;
+            shot->vel = shots[0].vel;
+        }
+    }
+}
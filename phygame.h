@@ -0,0 +1,72 @@
+/**
+ * @file phygame.h
+ * @brief Header file for the native eight-ball rules layer built on the physics library.
+ *
+ * This header declares the game state, the shot policy interface and the functions that rack,
+ * play turns and apply fouls, ball-in-hand and end-of-game rules without going through Python.
+ */
+
+#ifndef PHYGAME_H
+#define PHYGAME_H
+
+#include "phylib.h"
+
+#define PHYGAME_MAX_SHOTS (300)
+#define PHYGAME_RACK_GAP (4.0) // mm between racked balls
+#define PHYGAME_BREAK_SPEED (4000.0) // mm/s
+
+typedef enum {
+PHYGAME_OPEN = 0,
+PHYGAME_SOLIDS = 1,
+PHYGAME_STRIPES = 2,
+} phygame_group;
+
+typedef enum {
+PHYGAME_PHASE_RACK = 0,
+PHYGAME_PHASE_POLICY = 1,
+PHYGAME_PHASE_SIMULATE = 2,
+PHYGAME_PHASE_RULES = 3,
+PHYGAME_PHASES = 4,
+} phygame_phase;
+
+typedef struct {
+int place; // non-zero to place the cue ball at pos, only honoured with ball in hand
+phylib_coord pos;
+phylib_coord vel;
+} phygame_shot;
+
+typedef struct phygame phygame;
+
+typedef void (*phygame_policy)( phygame *game, phygame_shot *shot );
+
+struct phygame {
+phylib_table *table;
+phygame_policy policy[2];
+phygame_group group[2];
+int turn; // player to shoot, 0 or 1
+int ball_in_hand;
+int winner; // -1 while playing, -2 for a draw at PHYGAME_MAX_SHOTS
+int shots;
+int fouls;
+unsigned int pocketed; // bit n is set once object ball n is down
+unsigned int seed;
+double phase_time[PHYGAME_PHASES]; // s
+};
+
+phygame *phygame_new( unsigned int seed, phygame_policy player1, phygame_policy player2 );
+
+void phygame_free( phygame *game );
+
+int phygame_turn( phygame *game );
+
+int phygame_play( phygame *game );
+
+int phygame_legal_target( phygame *game, unsigned char number );
+
+double phygame_random( phygame *game );
+
+void phygame_random_policy( phygame *game, phygame_shot *shot );
+
+void phygame_greedy_policy( phygame *game, phygame_shot *shot );
+
+#endif
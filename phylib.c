@@ -8,6 +8,17 @@
 
 #include "phylib.h"
 
+// keep kernel arithmetic in the precision of the build
+#define PHYLIB_R(x) ((phylib_real)(x))
+
+#ifdef PHYLIB_SINGLE
+#define phylib_sqrt sqrtf
+#define phylib_fabs fabsf
+#else
+#define phylib_sqrt sqrt
+#define phylib_fabs fabs
+#endif
+
 /**
  * Creates a new still ball object with the specified number and position.
  * 
@@ -97,7 +108,7 @@ phylib_object *phylib_new_hole(phylib_coord *pos) {
  * @param y The y-coordinate of the horizontal cushion.
  * @return  A pointer to the newly created horizontal cushion object, or NULL if memory allocation fails.
  */
-phylib_object *phylib_new_hcushion(double y) {
+phylib_object *phylib_new_hcushion(phylib_real y) {
     
     // initializing new h cushion, and allocating memory
     phylib_object * new_hcushion = (phylib_object *)calloc(1, sizeof(phylib_object));
@@ -120,7 +131,7 @@ phylib_object *phylib_new_hcushion(double y) {
  * @param x The x-coordinate of the vertical cushion.
  * @return  A pointer to the newly created vertical cushion object, or NULL if memory allocation fails.
  */
-phylib_object *phylib_new_vcushion(double x) {
+phylib_object *phylib_new_vcushion(phylib_real x) {
 
     // initializing new v cushion, and allocating memory
     phylib_object * new_vcushion = (phylib_object *)calloc(1, sizeof(phylib_object));
@@ -237,6 +248,16 @@ phylib_table *phylib_copy_table(phylib_table *table) {
     // assign time from old table to new table
     new_table->time = table->time;
 
+    // a table with spin keeps it in its own array
+    if (table->spin != NULL) {
+        new_table->spin = (phylib_spin *)malloc(PHYLIB_MAX_OBJECTS * sizeof(phylib_spin));
+        if (new_table->spin == NULL) {
+            phylib_free_table(new_table);
+            return NULL;
+        }
+        memcpy(new_table->spin, table->spin, PHYLIB_MAX_OBJECTS * sizeof(phylib_spin));
+    }
+
     return new_table;
 
 }
@@ -258,8 +279,11 @@ void phylib_add_object(phylib_table *table, phylib_object *object) {
     for (int i = 0; i < PHYLIB_MAX_OBJECTS; i++) {
         // check if null, indicating an empty space
         if (table->object[i] == NULL) {
-            // assign the object in empty space
+            // assign the object in empty space, without spin left over from an earlier ball
             table->object[i] = object;
+            if (table->spin != NULL) {
+                memset(&table->spin[i], 0, sizeof(phylib_spin));
+            }
             return;
         }
     }
@@ -286,6 +310,7 @@ void phylib_free_table(phylib_table *table) {
             table->object[i] = NULL;
         }
     }
+    free(table->spin);
     free(table);
 }
 
@@ -312,10 +337,10 @@ phylib_coord phylib_sub(phylib_coord c1, phylib_coord c2) {
  * @param c The coordinate.
  * @return  The length of the coordinate.
  */
-double phylib_length(phylib_coord c) {
+phylib_real phylib_length(phylib_coord c) {
 
     // compute length
-    return sqrt((c.x * c.x) + (c.y * c.y));
+    return phylib_sqrt((c.x * c.x) + (c.y * c.y));
 }
 
 /**
@@ -325,7 +350,7 @@ double phylib_length(phylib_coord c) {
  * @param b The second coordinate.
  * @return  The dot product of a and b.
  */
-double phylib_dot_product(phylib_coord a, phylib_coord b) {
+phylib_real phylib_dot_product(phylib_coord a, phylib_coord b) {
 
     // compute dot product
     return (a.x * b.x) + (a.y * b.y);
@@ -338,7 +363,7 @@ double phylib_dot_product(phylib_coord a, phylib_coord b) {
  * @param obj2 The second object.
  * @return     The distance between obj1 and obj2, or -1 if an error occurs.
  */
-double phylib_distance(phylib_object *obj1, phylib_object *obj2) {
+phylib_real phylib_distance(phylib_object *obj1, phylib_object *obj2) {
 
     // check if parameters are null before proceeding
     if (obj1 == NULL || obj2 == NULL) {
@@ -352,19 +377,19 @@ double phylib_distance(phylib_object *obj1, phylib_object *obj2) {
 
     // compute distances for each case
     if (obj2->type == PHYLIB_ROLLING_BALL) {
-        return ((phylib_length(phylib_sub(obj1->obj.rolling_ball.pos, obj2->obj.rolling_ball.pos))) - PHYLIB_BALL_DIAMETER);
+        return ((phylib_length(phylib_sub(obj1->obj.rolling_ball.pos, obj2->obj.rolling_ball.pos))) - PHYLIB_R(PHYLIB_BALL_DIAMETER));
 
     } else if (obj2->type == PHYLIB_STILL_BALL) {
-        return ((phylib_length(phylib_sub(obj1->obj.rolling_ball.pos, obj2->obj.still_ball.pos))) - PHYLIB_BALL_DIAMETER);
+        return ((phylib_length(phylib_sub(obj1->obj.rolling_ball.pos, obj2->obj.still_ball.pos))) - PHYLIB_R(PHYLIB_BALL_DIAMETER));
 
     } else if (obj2->type == PHYLIB_HOLE) {
-        return ((phylib_length(phylib_sub(obj1->obj.rolling_ball.pos, obj2->obj.hole.pos))) - PHYLIB_HOLE_RADIUS);
+        return ((phylib_length(phylib_sub(obj1->obj.rolling_ball.pos, obj2->obj.hole.pos))) - PHYLIB_R(PHYLIB_HOLE_RADIUS));
 
     } else if (obj2->type == PHYLIB_HCUSHION) {
-        return (fabs(obj1->obj.rolling_ball.pos.y - obj2->obj.hcushion.y)) - PHYLIB_BALL_RADIUS;
+        return (phylib_fabs(obj1->obj.rolling_ball.pos.y - obj2->obj.hcushion.y)) - PHYLIB_R(PHYLIB_BALL_RADIUS);
 
     } else if (obj2->type == PHYLIB_VCUSHION) {
-        return (fabs(obj1->obj.rolling_ball.pos.x - obj2->obj.vcushion.x)) - PHYLIB_BALL_RADIUS;
+        return (phylib_fabs(obj1->obj.rolling_ball.pos.x - obj2->obj.vcushion.x)) - PHYLIB_R(PHYLIB_BALL_RADIUS);
 
     } else {
         return -1;
@@ -379,7 +404,7 @@ double phylib_distance(phylib_object *obj1, phylib_object *obj2) {
  * @param old  A pointer to the original rolling ball object.
  * @param time The time interval for which the rolling ball is updated.
  */
-void phylib_roll(phylib_object *new, phylib_object *old, double time) {
+void phylib_roll(phylib_object *new, phylib_object *old, phylib_real time) {
 
     // null check parameters for proceeding
     if (new == NULL || old == NULL) {
@@ -395,13 +420,13 @@ void phylib_roll(phylib_object *new, phylib_object *old, double time) {
     new->obj.rolling_ball.pos.x = 
         (old->obj.rolling_ball.pos.x) +
         (old->obj.rolling_ball.vel.x * time) +
-        ((0.5) * (old->obj.rolling_ball.acc.x) * (time * time));
+        (PHYLIB_R(0.5) * (old->obj.rolling_ball.acc.x) * (time * time));
 
     // compute y position of our new ball
     new->obj.rolling_ball.pos.y = 
         (old->obj.rolling_ball.pos.y) +
         (old->obj.rolling_ball.vel.y * time) +
-        ((0.5) * (old->obj.rolling_ball.acc.y) * (time * time));
+        (PHYLIB_R(0.5) * (old->obj.rolling_ball.acc.y) * (time * time));
 
     // compute x velocity of our new ball
     new->obj.rolling_ball.vel.x =
@@ -446,7 +471,7 @@ unsigned char phylib_stopped(phylib_object *object) {
     }
 
     // if object is going slow enough, change it a still ball
-    if (phylib_length(object->obj.rolling_ball.vel) < PHYLIB_VEL_EPSILON) {
+    if (phylib_length(object->obj.rolling_ball.vel) < PHYLIB_R(PHYLIB_VEL_EPSILON)) {
         object->type = PHYLIB_STILL_BALL;
         object->obj.still_ball.pos = object->obj.rolling_ball.pos;
         object->obj.still_ball.number = object->obj.rolling_ball.number;
@@ -483,14 +508,14 @@ void phylib_bounce(phylib_object **a, phylib_object **b) {
 
         // change direction of y comp if it hits a horizontal cushion
         case PHYLIB_HCUSHION:
-            (*a)->obj.rolling_ball.vel.y = ((*a)->obj.rolling_ball.vel.y) * (-1.0);
-            (*a)->obj.rolling_ball.acc.y = ((*a)->obj.rolling_ball.acc.y) * (-1.0);
+            (*a)->obj.rolling_ball.vel.y = ((*a)->obj.rolling_ball.vel.y) * PHYLIB_R(-1.0);
+            (*a)->obj.rolling_ball.acc.y = ((*a)->obj.rolling_ball.acc.y) * PHYLIB_R(-1.0);
             break;
 
         // change direction of x comp if it hits a vertical cushion
         case PHYLIB_VCUSHION: 
-            (*a)->obj.rolling_ball.vel.x = ((*a)->obj.rolling_ball.vel.x) * (-1.0);
-            (*a)->obj.rolling_ball.acc.x = ((*a)->obj.rolling_ball.acc.x) * (-1.0);
+            (*a)->obj.rolling_ball.vel.x = ((*a)->obj.rolling_ball.vel.x) * PHYLIB_R(-1.0);
+            (*a)->obj.rolling_ball.acc.x = ((*a)->obj.rolling_ball.acc.x) * PHYLIB_R(-1.0);
             break;
 
         // free ball if it lands in hole
@@ -516,7 +541,7 @@ void phylib_bounce(phylib_object **a, phylib_object **b) {
             phylib_coord n;
             n.x = (r_ab.x) / (phylib_length(r_ab));
             n.y = (r_ab.y) / (phylib_length(r_ab));
-            double v_rel_n = phylib_dot_product(v_rel, n);
+            phylib_real v_rel_n = phylib_dot_product(v_rel, n);
 
             (*a)->obj.rolling_ball.vel.x -= (v_rel_n * n.x);
             (*a)->obj.rolling_ball.vel.y -= (v_rel_n * n.y);
@@ -524,16 +549,23 @@ void phylib_bounce(phylib_object **a, phylib_object **b) {
             (*b)->obj.rolling_ball.vel.x += (v_rel_n * n.x);
             (*b)->obj.rolling_ball.vel.y += (v_rel_n * n.y);
 
-            double speed_a = phylib_length((*a)->obj.rolling_ball.vel);
-            double speed_b = phylib_length((*b)->obj.rolling_ball.vel);
+            phylib_real speed_a = phylib_length((*a)->obj.rolling_ball.vel);
+            phylib_real speed_b = phylib_length((*b)->obj.rolling_ball.vel);
 
-            if (speed_a > PHYLIB_VEL_EPSILON) {
-                (*a)->obj.rolling_ball.acc.x = ((((*a)->obj.rolling_ball.vel.x) * (-1.0)) / (speed_a)) * PHYLIB_DRAG;
-                (*a)->obj.rolling_ball.acc.y = ((((*a)->obj.rolling_ball.vel.y) * (-1.0)) / (speed_a)) * PHYLIB_DRAG;
-            } 
-            if (speed_b > PHYLIB_VEL_EPSILON) {
-                (*b)->obj.rolling_ball.acc.x = ((((*b)->obj.rolling_ball.vel.x) * (-1.0)) / (speed_b)) * PHYLIB_DRAG;
-                (*b)->obj.rolling_ball.acc.y = ((((*b)->obj.rolling_ball.vel.y) * (-1.0)) / (speed_b)) * PHYLIB_DRAG;
+            if (speed_a > PHYLIB_R(PHYLIB_VEL_EPSILON)) {
+                (*a)->obj.rolling_ball.acc.x = ((((*a)->obj.rolling_ball.vel.x) * PHYLIB_R(-1.0)) / (speed_a)) * PHYLIB_R(PHYLIB_DRAG);
+                (*a)->obj.rolling_ball.acc.y = ((((*a)->obj.rolling_ball.vel.y) * PHYLIB_R(-1.0)) / (speed_a)) * PHYLIB_R(PHYLIB_DRAG);
+            } else {
+                // drag left over from before the hit would push a ball that is all but stopped
+                (*a)->obj.rolling_ball.acc.x = 0.0;
+                (*a)->obj.rolling_ball.acc.y = 0.0;
+            }
+            if (speed_b > PHYLIB_R(PHYLIB_VEL_EPSILON)) {
+                (*b)->obj.rolling_ball.acc.x = ((((*b)->obj.rolling_ball.vel.x) * PHYLIB_R(-1.0)) / (speed_b)) * PHYLIB_R(PHYLIB_DRAG);
+                (*b)->obj.rolling_ball.acc.y = ((((*b)->obj.rolling_ball.vel.y) * PHYLIB_R(-1.0)) / (speed_b)) * PHYLIB_R(PHYLIB_DRAG);
+            } else {
+                (*b)->obj.rolling_ball.acc.x = 0.0;
+                (*b)->obj.rolling_ball.acc.y = 0.0;
             }
             break; }
     }
@@ -567,13 +599,279 @@ unsigned char phylib_rolling(phylib_table *t) {
     return rolling_count;
 }
 
+/**
+ * Checks whether a rolling ball is moving towards an object it overlaps. Overlaps that are
+ * already separating, as left behind by the previous collision in a tight cluster of balls,
+ * must not be resolved again or the pair keeps swapping velocities without moving.
+ * 
+ * @param a A pointer to the rolling ball.
+ * @param b A pointer to the object it overlaps.
+ * @return  1 if the collision still has to be resolved, otherwise 0.
+ */
+static int phylib_approaching(phylib_object *a, phylib_object *b) {
+
+    phylib_coord pos = a->obj.rolling_ball.pos;
+    phylib_coord vel = a->obj.rolling_ball.vel;
+
+    switch (b->type) {
+        case PHYLIB_HCUSHION:
+            return (pos.y - b->obj.hcushion.y) * vel.y < 0.0;
+        case PHYLIB_VCUSHION:
+            return (pos.x - b->obj.vcushion.x) * vel.x < 0.0;
+        case PHYLIB_ROLLING_BALL:
+            vel = phylib_sub(vel, b->obj.rolling_ball.vel);
+            return phylib_dot_product(phylib_sub(pos, b->obj.rolling_ball.pos), vel) < 0.0;
+        case PHYLIB_STILL_BALL:
+            return phylib_dot_product(phylib_sub(pos, b->obj.still_ball.pos), vel) < 0.0;
+        default:
+            return 1;
+    }
+}
+
+/**
+ * Updates the outputs of a stop request for a collision that is about to be resolved, and
+ * marks the predicate that fired, if any.
+ * 
+ * @param stop A pointer to the stop request.
+ * @param a    A pointer to the rolling ball involved in the collision.
+ * @param b    A pointer to the object it collided with.
+ */
+static void phylib_stop_event(phylib_stop *stop, phylib_object *a, phylib_object *b) {
+
+    unsigned char number = a->obj.rolling_ball.number;
+
+    if (b->type == PHYLIB_HOLE) {
+        // record the drop before phylib_bounce frees the ball
+        if (number < 32) {
+            stop->pocketed |= 1u << number;
+        }
+        if ((stop->predicates & PHYLIB_STOP_BALL_POCKETED) && number == stop->ball) {
+            stop->fired = PHYLIB_STOP_BALL_POCKETED;
+        } else if ((stop->predicates & PHYLIB_STOP_CUE_POCKETED) && number == 0) {
+            stop->fired = PHYLIB_STOP_CUE_POCKETED;
+        } else if (stop->predicates & PHYLIB_STOP_ANY_POCKETED) {
+            stop->fired = PHYLIB_STOP_ANY_POCKETED;
+        }
+
+    } else if ((b->type == PHYLIB_STILL_BALL || b->type == PHYLIB_ROLLING_BALL) && stop->first_contact < 0) {
+        // number is the first member of both ball structs
+        unsigned char other = b->obj.still_ball.number;
+        if (number == 0 || other == 0) {
+            stop->first_contact = number == 0 ? other : number;
+            if (stop->predicates & PHYLIB_STOP_FIRST_CONTACT) {
+                stop->fired = PHYLIB_STOP_FIRST_CONTACT;
+            }
+        }
+    }
+}
+
+/**
+ * Motion of one ball over a segment on a table with spin. While the contact point slips on the
+ * cloth the ball slides: friction acts against the slip, whose direction does not change, so the
+ * slip dies out at a time known in advance. After that the ball rolls with PHYLIB_DRAG.
+ */
+typedef struct {
+phylib_real slide; // time the ball starts rolling, 0 if it already rolls
+phylib_object start; // state at the start of the segment, with the sliding acceleration
+phylib_object rolled; // state when sliding ends, with the rolling drag
+phylib_spin spin; // angular velocity at the start of the segment
+phylib_coord alpha; // angular acceleration of x and y spin while sliding
+} phylib_motion;
+
+/**
+ * Works out the sliding and rolling phases of a ball for a segment.
+ * 
+ * @param motion A pointer to the motion to fill in.
+ * @param ball   A pointer to the ball, may be NULL or not rolling.
+ * @param spin   A pointer to the angular velocity of the ball.
+ */
+static void phylib_motion_start(phylib_motion *motion, phylib_object *ball, phylib_spin *spin) {
+
+    motion->slide = 0.0;
+    if (ball == NULL || ball->type != PHYLIB_ROLLING_BALL) {
+        return;
+    }
+
+    motion->start = *ball;
+    motion->rolled = *ball;
+    motion->spin = *spin;
+
+    phylib_coord vel = ball->obj.rolling_ball.vel;
+    phylib_coord acc = { 0.0, 0.0 };
+
+    // velocity of the point touching the cloth
+    phylib_coord slip;
+    slip.x = vel.x - PHYLIB_R(PHYLIB_BALL_RADIUS) * spin->y;
+    slip.y = vel.y + PHYLIB_R(PHYLIB_BALL_RADIUS) * spin->x;
+    phylib_real slip_speed = phylib_length(slip);
+
+    if (slip_speed > PHYLIB_R(PHYLIB_VEL_EPSILON)) {
+        // friction slows the slip at 7/2 the rate it slows the ball, as the spin absorbs the rest
+        phylib_real friction = PHYLIB_R(PHYLIB_SLIDE_FRICTION * PHYLIB_GRAVITY);
+        phylib_real torque = PHYLIB_R(2.5 * PHYLIB_SLIDE_FRICTION * PHYLIB_GRAVITY / PHYLIB_BALL_RADIUS);
+        phylib_real t = slip_speed / (PHYLIB_R(3.5) * friction);
+
+        acc.x = slip.x * PHYLIB_R(-1.0) / slip_speed * friction;
+        acc.y = slip.y * PHYLIB_R(-1.0) / slip_speed * friction;
+        motion->alpha.x = slip.y * PHYLIB_R(-1.0) / slip_speed * torque;
+        motion->alpha.y = slip.x / slip_speed * torque;
+        motion->slide = t;
+
+        motion->rolled.obj.rolling_ball.pos.x += vel.x * t + PHYLIB_R(0.5) * acc.x * t * t;
+        motion->rolled.obj.rolling_ball.pos.y += vel.y * t + PHYLIB_R(0.5) * acc.y * t * t;
+        motion->rolled.obj.rolling_ball.vel.x += acc.x * t;
+        motion->rolled.obj.rolling_ball.vel.y += acc.y * t;
+    }
+    motion->start.obj.rolling_ball.acc = acc;
+
+    // drag always points against the direction of travel
+    phylib_coord rolled = motion->rolled.obj.rolling_ball.vel;
+    phylib_real speed = phylib_length(rolled);
+    motion->rolled.obj.rolling_ball.acc.x = 0.0;
+    motion->rolled.obj.rolling_ball.acc.y = 0.0;
+    if (speed > PHYLIB_R(PHYLIB_VEL_EPSILON)) {
+        motion->rolled.obj.rolling_ball.acc.x = ((rolled.x * PHYLIB_R(-1.0)) / speed) * PHYLIB_R(PHYLIB_DRAG);
+        motion->rolled.obj.rolling_ball.acc.y = ((rolled.y * PHYLIB_R(-1.0)) / speed) * PHYLIB_R(PHYLIB_DRAG);
+    }
+}
+
+/**
+ * Moves a ball on a table with spin to its state a given time into the segment.
+ * 
+ * @param ball   A pointer to the rolling ball to update.
+ * @param motion A pointer to the motion of the ball over the segment.
+ * @param time   The time since the start of the segment.
+ */
+static void phylib_motion_roll(phylib_object *ball, phylib_motion *motion, phylib_real time) {
+
+    if (time >= motion->slide) {
+        phylib_roll(ball, &motion->rolled, time - motion->slide);
+        return;
+    }
+
+    // unlike rolling, sliding may reverse the ball, so there is no stop at zero speed here
+    phylib_rolling_ball *start = &motion->start.obj.rolling_ball;
+    ball->obj.rolling_ball.pos.x = start->pos.x + start->vel.x * time + PHYLIB_R(0.5) * start->acc.x * time * time;
+    ball->obj.rolling_ball.pos.y = start->pos.y + start->vel.y * time + PHYLIB_R(0.5) * start->acc.y * time * time;
+    ball->obj.rolling_ball.vel.x = start->vel.x + start->acc.x * time;
+    ball->obj.rolling_ball.vel.y = start->vel.y + start->acc.y * time;
+    ball->obj.rolling_ball.acc = start->acc;
+}
+
+/**
+ * Brings the angular velocity of every rolling ball up to a given time into the segment.
+ * 
+ * @param table  A pointer to the table being simulated, with its balls already moved to time.
+ * @param motion The motions of the balls over the segment, indexed by slot.
+ * @param time   The time since the start of the segment.
+ */
+static void phylib_motion_spin(phylib_table *table, phylib_motion *motion, phylib_real time) {
+
+    phylib_real decay = PHYLIB_R(2.5 * PHYLIB_SPIN_FRICTION * PHYLIB_GRAVITY / PHYLIB_BALL_RADIUS) * time;
+
+    for (int i = 10; i < PHYLIB_MAX_OBJECTS; i++) {
+        phylib_object *ball = table->object[i];
+        if (ball == NULL || ball->type != PHYLIB_ROLLING_BALL) {
+            continue;
+        }
+        phylib_spin *spin = &table->spin[i];
+
+        if (time < motion[i].slide) {
+            spin->x = motion[i].spin.x + motion[i].alpha.x * time;
+            spin->y = motion[i].spin.y + motion[i].alpha.y * time;
+        } else {
+            // a rolling ball turns exactly as fast as it moves
+            spin->x = ball->obj.rolling_ball.vel.y * PHYLIB_R(-1.0) / PHYLIB_R(PHYLIB_BALL_RADIUS);
+            spin->y = ball->obj.rolling_ball.vel.x / PHYLIB_R(PHYLIB_BALL_RADIUS);
+        }
+
+        // side spin only wears off
+        phylib_real z = motion[i].spin.z;
+        spin->z = z > decay ? z - decay : z < -decay ? z + decay : PHYLIB_R(0.0);
+    }
+}
+
+/**
+ * Performs collision handling on a table with spin. Besides phylib_bounce, a ball hitting a
+ * cushion has the slip of its contact point along the cushion reduced by friction, which turns
+ * side spin into a change of the rebound angle and the other way around.
+ * 
+ * @param table A pointer to the table.
+ * @param i     The slot of the rolling ball.
+ * @param j     The slot of the object it collided with.
+ */
+static void phylib_bounce_spin(phylib_table *table, int i, int j) {
+
+    phylib_obj type = table->object[j]->type;
+    phylib_bounce(&(table->object[i]), &(table->object[j]));
+
+    phylib_spin *spin = &table->spin[i];
+    if (table->object[i] == NULL) {
+        memset(spin, 0, sizeof(phylib_spin));
+        return;
+    }
+    if (type != PHYLIB_HCUSHION && type != PHYLIB_VCUSHION) {
+        return;
+    }
+
+    phylib_rolling_ball *ball = &table->object[i]->obj.rolling_ball;
+    phylib_real *along;
+    phylib_real side; // +1 or -1, turns side spin into slip along the cushion
+    phylib_real normal_speed;
+    if (type == PHYLIB_HCUSHION) {
+        along = &ball->vel.x;
+        side = ball->pos.y > table->object[j]->obj.hcushion.y ? PHYLIB_R(1.0) : PHYLIB_R(-1.0);
+        normal_speed = phylib_fabs(ball->vel.y);
+    } else {
+        along = &ball->vel.y;
+        side = ball->pos.x > table->object[j]->obj.vcushion.x ? PHYLIB_R(-1.0) : PHYLIB_R(1.0);
+        normal_speed = phylib_fabs(ball->vel.x);
+    }
+
+    // the impulse that stops the slip, limited by friction against the normal impulse
+    phylib_real slip = *along + side * PHYLIB_R(PHYLIB_BALL_RADIUS) * spin->z;
+    phylib_real impulse = slip * PHYLIB_R(-2.0 / 7.0);
+    phylib_real limit = PHYLIB_R(2.0 * PHYLIB_CUSHION_FRICTION) * normal_speed;
+    if (impulse > limit) {
+        impulse = limit;
+    } else if (impulse < -limit) {
+        impulse = -limit;
+    }
+
+    *along += impulse;
+    spin->z += side * PHYLIB_R(2.5) * impulse / PHYLIB_R(PHYLIB_BALL_RADIUS);
+}
+
+// the kernel without spin, then the one with it
+#define PHYLIB_KERNEL_SPIN 0
+#define PHYLIB_KERNEL(name) name##_plain
+#include "phylib_kernel.h"
+#undef PHYLIB_KERNEL
+#undef PHYLIB_KERNEL_SPIN
+
+#define PHYLIB_KERNEL_SPIN 1
+#define PHYLIB_KERNEL(name) name##_spin
+#include "phylib_kernel.h"
+#undef PHYLIB_KERNEL
+#undef PHYLIB_KERNEL_SPIN
+
 /**
  * Simulates the physics of the table for a small time segment, updating the positions and velocities of objects accordingly.
+ *
+ * Besides ending at the next collision or stopping ball like phylib_segment, the segment also ends
+ * once stop time has passed since the start time of the stop request, if PHYLIB_STOP_TIME is requested. Collisions update
+ * the first contact and pocketed outputs of the stop request and set fired when a predicate holds.
+ * Tables with spin are simulated by their own kernel; the choice is made once per segment.
+ *
+ * The outputs accumulate over segments, so a caller that drives this function itself must set
+ * them up the way phylib_simulate does before the first segment: fired and pocketed to 0, start
+ * to the table time and first_contact to -1. A zeroed request never records a first contact.
  * 
  * @param table A pointer to the table object to be simulated.
+ * @param stop  A pointer to the stop request, or NULL to simulate like phylib_segment.
  * @return      A pointer to a new table object representing the state after simulation, or NULL if no simulation is possible.
  */
-phylib_table *phylib_segment(phylib_table *table) {
+phylib_table *phylib_segment_until(phylib_table *table, phylib_stop *stop) {
 
     // null check on table
     if (table == NULL) {
@@ -584,53 +882,61 @@ phylib_table *phylib_segment(phylib_table *table) {
         return NULL;
     }
 
-    // initalize time to the sim rate
-    double time = PHYLIB_SIM_RATE;
+    if (table->spin != NULL) {
+        return phylib_segment_spin(table, stop);
+    }
+    return phylib_segment_plain(table, stop);
+}
 
-    // copy table from the table provided
-    phylib_table * new_table = phylib_copy_table(table);
+/**
+ * Simulates the physics of the table for a small time segment, updating the positions and velocities of objects accordingly.
+ * 
+ * @param table A pointer to the table object to be simulated.
+ * @return      A pointer to a new table object representing the state after simulation, or NULL if no simulation is possible.
+ */
+phylib_table *phylib_segment(phylib_table *table) {
 
-    // loop over time
-    while (new_table->time < PHYLIB_MAX_TIME) {
+    return phylib_segment_until(table, NULL);
+}
 
-        // loop over balls
-        for (int i = 10; i < PHYLIB_MAX_OBJECTS; i++) {
-            // roll out every ball
-            if (new_table->object[i] != NULL && new_table->object[i]->type == PHYLIB_ROLLING_BALL) {
-                phylib_roll(new_table->object[i], table->object[i], time);
-            }
+/**
+ * Simulates a whole shot, segment by segment, until every ball stops or a stop predicate fires.
+ *
+ * The outputs of the stop request are reset first, and its start is set to the table time, so
+ * the time predicate counts from the start of the shot. When the simulation ends, fired holds the
+ * predicate that ended it, or 0 if every ball came to rest.
+ * 
+ * @param table A pointer to the table object to be simulated, it is not modified.
+ * @param stop  A pointer to the stop request, or NULL to simulate until every ball stops.
+ * @return      A pointer to a new table object with the final state, or NULL if memory allocation fails.
+ */
+phylib_table *phylib_simulate(phylib_table *table, phylib_stop *stop) {
 
-        }
+    // null check on table
+    if (table == NULL) {
+        return NULL;
+    }
 
-            // loop over all objects
-            for (int i = 10; i < PHYLIB_MAX_OBJECTS; i++) {
-
-                for (int j = 0; j < PHYLIB_MAX_OBJECTS; j++) {
-                    if (new_table->object[j] != NULL && j != i) {
-                        
-                        // check if 2 objects are close enough for collision
-                        if (phylib_distance(new_table->object[i], new_table->object[j]) < 0.0 
-                        && phylib_distance(new_table->object[i], new_table->object[j]) != -1) {
-                        
-                            // do collision measures
-                            phylib_bounce(&(new_table->object[i]), &(new_table->object[j]));
-                            new_table->time += time;
-                            return new_table;
-                        }
-                    }
+    if (stop != NULL) {
+        stop->start = table->time;
+        stop->fired = 0;
+        stop->first_contact = -1;
+        stop->pocketed = 0;
+    }
 
-                }
-                
-                if (phylib_stopped(new_table->object[i]) == 1) {
-                    new_table->time += time;
-                    return new_table;
-                }
+    phylib_table *current = phylib_copy_table(table);
+    phylib_table *next;
 
-        } 
-        time += PHYLIB_SIM_RATE;
-    }      
-    new_table->time += time;
-    return new_table;
+    // keep going until nothing rolls, a predicate fires or the table runs out of time
+    while (current != NULL && current->time < PHYLIB_MAX_TIME && (next = phylib_segment_until(current, stop)) != NULL) {
+        phylib_free_table(current);
+        current = next;
+        if (stop != NULL && stop->fired != 0) {
+            break;
+        }
+    }
+
+    return current;
 }
 
 /**
@@ -686,3 +992,416 @@ char *phylib_object_string(phylib_object *object) {
     return string;
 
 }
+
+
+/**
+ * Finds the table slot holding the ball with the given number.
+ * 
+ * @param table  A pointer to the table object.
+ * @param number The number of the ball.
+ * @return       The index of the ball in the object array, or -1 if it is not on the table.
+ */
+static int phylib_find_ball(phylib_table *table, unsigned char number) {
+
+    for (int i = 10; i < PHYLIB_MAX_OBJECTS; i++) {
+        phylib_object *object = table->object[i];
+        if (object == NULL) {
+            continue;
+        }
+        // number is the first member of both ball structs
+        if ((object->type == PHYLIB_STILL_BALL || object->type == PHYLIB_ROLLING_BALL)
+        && object->obj.still_ball.number == number) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Sets a still ball rolling with the given velocity and the matching drag.
+ * 
+ * @param table  A pointer to the table object.
+ * @param number The number of the ball to strike, 0 for the cue ball.
+ * @param vel    A pointer to the velocity given to the ball.
+ * @return       A pointer to the struck ball, or NULL if the ball is not on the table.
+ */
+phylib_object *phylib_strike(phylib_table *table, unsigned char number, phylib_coord *vel) {
+
+    // null check parameters before proceeding
+    if (table == NULL || vel == NULL) {
+        return NULL;
+    }
+
+    int i = phylib_find_ball(table, number);
+    if (i < 0) {
+        return NULL;
+    }
+
+    phylib_object *ball = table->object[i];
+    phylib_coord pos = ball->obj.still_ball.pos;
+    phylib_real speed = phylib_length(*vel);
+
+    ball->type = PHYLIB_ROLLING_BALL;
+    ball->obj.rolling_ball.number = number;
+    ball->obj.rolling_ball.pos = pos;
+    ball->obj.rolling_ball.vel = *vel;
+    ball->obj.rolling_ball.acc.x = 0.0;
+    ball->obj.rolling_ball.acc.y = 0.0;
+
+    // drag always points against the direction of travel
+    if (speed > PHYLIB_R(PHYLIB_VEL_EPSILON)) {
+        ball->obj.rolling_ball.acc.x = ((vel->x * PHYLIB_R(-1.0)) / speed) * PHYLIB_R(PHYLIB_DRAG);
+        ball->obj.rolling_ball.acc.y = ((vel->y * PHYLIB_R(-1.0)) / speed) * PHYLIB_R(PHYLIB_DRAG);
+    }
+
+    return ball;
+}
+
+/**
+ * Gives a table spin, so its balls slide until friction makes them roll and carry english into
+ * cushions. Balls already on the table start without spin. Tables without spin keep the plain
+ * rolling kernel.
+ * 
+ * @param table A pointer to the table object.
+ * @return      0 on success, or -1 if memory allocation fails.
+ */
+int phylib_enable_spin(phylib_table *table) {
+
+    // null check parameters before proceeding
+    if (table == NULL) {
+        return -1;
+    }
+    if (table->spin == NULL) {
+        table->spin = (phylib_spin *)calloc(PHYLIB_MAX_OBJECTS, sizeof(phylib_spin));
+    }
+    return table->spin == NULL ? -1 : 0;
+}
+
+/**
+ * Strikes a ball off centre, on a table that is given spin if it has none yet. The cue tip meets
+ * the ball side * radius to the right of the line of aim and height * radius above the centre.
+ * A height of 0.4 sends the ball off rolling, 0 slides it (a stun shot) and negative heights
+ * give draw. Offsets beyond half the radius would miscue on a real table.
+ * 
+ * @param table  A pointer to the table object.
+ * @param number The number of the ball to strike, 0 for the cue ball.
+ * @param vel    A pointer to the velocity given to the ball.
+ * @param side   The sideways offset of the cue tip, in ball radii.
+ * @param height The vertical offset of the cue tip, in ball radii.
+ * @return       A pointer to the struck ball, or NULL if the ball is not on the table or memory allocation fails.
+ */
+phylib_object *phylib_strike_spin(phylib_table *table, unsigned char number, phylib_coord *vel,
+                                  phylib_real side, phylib_real height) {
+
+    if (phylib_enable_spin(table) != 0) {
+        return NULL;
+    }
+    phylib_object *ball = phylib_strike(table, number, vel);
+    if (ball == NULL) {
+        return NULL;
+    }
+
+    phylib_spin *spin = &table->spin[phylib_find_ball(table, number)];
+    memset(spin, 0, sizeof(phylib_spin));
+
+    // an impulse through the tip spins the ball about the axis across the shot and about the vertical
+    phylib_real speed = phylib_length(*vel);
+    if (speed > PHYLIB_R(PHYLIB_VEL_EPSILON)) {
+        phylib_real rate = PHYLIB_R(2.5) / PHYLIB_R(PHYLIB_BALL_RADIUS);
+        spin->x = vel->y * PHYLIB_R(-1.0) * height * rate;
+        spin->y = vel->x * height * rate;
+        spin->z = speed * side * PHYLIB_R(-1.0) * rate;
+    }
+
+    return ball;
+}
+
+/**
+ * Shoots the cue ball and checks whether the target ball is pocketed.
+ *
+ * The simulation stops as soon as the outcome is known: when the target drops, when the
+ * cue ball drops first, or when the target was hit but comes to rest on the table.
+ * 
+ * @param table  A pointer to the table object, it is not modified.
+ * @param target The number of the ball to pocket.
+ * @param vel    A pointer to the velocity given to the cue ball.
+ * @param shot   A pointer to a shot filled in when the target is pocketed, may be NULL.
+ * @return       1 if the target is pocketed, 0 if it was hit but stopped short, otherwise -1.
+ */
+int phylib_try_pocket(phylib_table *table, unsigned char target, phylib_coord *vel, phylib_shot *shot) {
+
+    // null check parameters before proceeding
+    if (table == NULL || vel == NULL) {
+        return -1;
+    }
+
+    int cue = phylib_find_ball(table, 0);
+    int ball = phylib_find_ball(table, target);
+    if (cue < 0 || ball < 0 || cue == ball) {
+        return -1;
+    }
+
+    phylib_table *current = phylib_copy_table(table);
+    if (current == NULL) {
+        return -1;
+    }
+
+    // the shot gets the full PHYLIB_MAX_TIME however long the table has been played on
+    current->time = 0.0;
+    phylib_strike(current, 0, vel);
+
+    int result = -1;
+    int target_moved = 0;
+
+    while (1) {
+        phylib_table *next = current->time < PHYLIB_MAX_TIME ? phylib_segment(current) : NULL;
+
+        // everything stopped, or time ran out, without the target dropping
+        if (next == NULL) {
+            result = target_moved ? 0 : -1;
+            break;
+        }
+
+        if (next->object[ball] == NULL) {
+            // roll the target to the moment it dropped and find the hole it fell into
+            phylib_object *before = current->object[ball];
+            phylib_object dropped = *before;
+            phylib_roll(&dropped, before, next->time - current->time);
+
+            phylib_real best = -1.0;
+            for (int h = 4; h < 10; h++) {
+                phylib_real d = phylib_length(phylib_sub(dropped.obj.rolling_ball.pos, current->object[h]->obj.hole.pos));
+                if (best < 0.0 || d < best) {
+                    best = d;
+                    if (shot != NULL) {
+                        shot->hole = (unsigned char)h;
+                    }
+                }
+            }
+
+            if (shot != NULL) {
+                // margin is how far the travel line stayed inside the hole radius
+                phylib_coord dir = before->obj.rolling_ball.vel;
+                phylib_coord off = phylib_sub(current->object[shot->hole]->obj.hole.pos, before->obj.rolling_ball.pos);
+                phylib_real speed = phylib_length(dir);
+                phylib_real miss = speed > 0.0 ? phylib_fabs(off.x * dir.y - off.y * dir.x) / speed : 0.0;
+                shot->vel = *vel;
+                shot->margin = PHYLIB_HOLE_RADIUS - miss;
+            }
+
+            result = 1;
+            phylib_free_table(next);
+            break;
+        }
+
+        // scratch before the target dropped
+        if (next->object[cue] == NULL) {
+            phylib_free_table(next);
+            break;
+        }
+
+        if (next->object[ball]->type == PHYLIB_ROLLING_BALL) {
+            target_moved = 1;
+        } else if (target_moved) {
+            result = 0;
+            phylib_free_table(next);
+            break;
+        }
+
+        phylib_free_table(current);
+        current = next;
+    }
+
+    phylib_free_table(current);
+    return result;
+}
+
+/**
+ * Computes the distance from a point to a line segment.
+ * 
+ * @param a The start of the segment.
+ * @param b The end of the segment.
+ * @param p The point.
+ * @return  The shortest distance between p and the segment.
+ */
+static phylib_real phylib_segment_distance(phylib_coord a, phylib_coord b, phylib_coord p) {
+
+    phylib_coord ab = phylib_sub(b, a);
+    phylib_coord ap = phylib_sub(p, a);
+    phylib_real len2 = phylib_dot_product(ab, ab);
+
+    // project onto the segment and clamp to its ends
+    phylib_real t = len2 > 0.0 ? phylib_dot_product(ap, ab) / len2 : 0.0;
+    if (t < 0.0) {
+        t = 0.0;
+    } else if (t > 1.0) {
+        t = 1.0;
+    }
+
+    phylib_coord closest = { a.x + ab.x * t, a.y + ab.y * t };
+    return phylib_length(phylib_sub(p, closest));
+}
+
+/**
+ * Checks whether a ball travelling along a segment would touch another ball or a hole on the way.
+ * 
+ * @param table  A pointer to the table object.
+ * @param a      The start of the path.
+ * @param b      The end of the path.
+ * @param skip1  A table slot ignored by the test, such as the moving ball itself.
+ * @param skip2  A second table slot ignored by the test, such as the destination hole.
+ * @return       1 if the path is blocked, otherwise 0.
+ */
+static int phylib_path_blocked(phylib_table *table, phylib_coord a, phylib_coord b, int skip1, int skip2) {
+
+    for (int i = 4; i < PHYLIB_MAX_OBJECTS; i++) {
+        phylib_object *object = table->object[i];
+        if (object == NULL || i == skip1 || i == skip2) {
+            continue;
+        }
+        if (object->type == PHYLIB_HOLE) {
+            if (phylib_segment_distance(a, b, object->obj.hole.pos) < PHYLIB_HOLE_RADIUS) {
+                return 1;
+            }
+        } else if (object->type == PHYLIB_STILL_BALL) {
+            if (phylib_segment_distance(a, b, object->obj.still_ball.pos) < PHYLIB_BALL_DIAMETER) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * Finds shots that pocket a target ball, best first.
+ *
+ * For every allowed hole the cue ball is aimed at the ghost ball position behind the target.
+ * Candidates whose cut is too thin, whose ghost ball is off the table, or whose cue or target
+ * path is blocked by another ball or a different hole are discarded without simulating. The
+ * remaining ones start at the slowest speed that reaches the hole under constant drag and are
+ * simulated, raising the speed while the target stops short.
+ * 
+ * @param table       A pointer to the table object, with every ball still.
+ * @param target      The number of the ball to pocket.
+ * @param holes       The table slots (4 to 9) of the allowed holes, or NULL for all six.
+ * @param hole_count  The number of entries in holes.
+ * @param shots       An array receiving the shots found, ranked by margin.
+ * @param max_shots   The size of the shots array.
+ * @param simulations A pointer receiving the number of simulated shots, may be NULL.
+ * @return            The number of shots written, or -1 if the cue ball or target is missing.
+ */
+int phylib_solve_pocket(phylib_table *table, unsigned char target, const unsigned char *holes, int hole_count,
+                        phylib_shot *shots, int max_shots, int *simulations) {
+
+    static const unsigned char all_holes[] = { 4, 5, 6, 7, 8, 9 };
+    int found = 0;
+    int simulated = 0;
+
+    if (simulations != NULL) {
+        *simulations = 0;
+    }
+
+    // null check parameters before proceeding
+    if (table == NULL || shots == NULL) {
+        return -1;
+    }
+    if (holes == NULL) {
+        holes = all_holes;
+        hole_count = 6;
+    }
+
+    int cue = phylib_find_ball(table, 0);
+    int ball = phylib_find_ball(table, target);
+    if (cue < 0 || ball < 0 || cue == ball) {
+        return -1;
+    }
+
+    phylib_coord cue_pos = table->object[cue]->obj.still_ball.pos;
+    phylib_coord ball_pos = table->object[ball]->obj.still_ball.pos;
+
+    for (int h = 0; h < hole_count; h++) {
+        int slot = holes[h];
+        if (slot < 4 || slot > 9 || table->object[slot] == NULL) {
+            continue;
+        }
+        phylib_coord hole_pos = table->object[slot]->obj.hole.pos;
+
+        // ghost ball: where the cue ball must be at contact to send the target at the hole
+        phylib_coord to_hole = phylib_sub(hole_pos, ball_pos);
+        phylib_real hole_dist = phylib_length(to_hole);
+        phylib_coord dir = { to_hole.x / hole_dist, to_hole.y / hole_dist };
+        phylib_coord ghost = { ball_pos.x - dir.x * PHYLIB_BALL_DIAMETER, ball_pos.y - dir.y * PHYLIB_BALL_DIAMETER };
+
+        if (ghost.x < PHYLIB_BALL_RADIUS || ghost.x > PHYLIB_TABLE_WIDTH - PHYLIB_BALL_RADIUS
+        || ghost.y < PHYLIB_BALL_RADIUS || ghost.y > PHYLIB_TABLE_LENGTH - PHYLIB_BALL_RADIUS) {
+            continue;
+        }
+
+        phylib_coord to_ghost = phylib_sub(ghost, cue_pos);
+        phylib_real cue_dist = phylib_length(to_ghost);
+        if (cue_dist <= 0.0) {
+            continue;
+        }
+        phylib_coord aim = { to_ghost.x / cue_dist, to_ghost.y / cue_dist };
+
+        // the target leaves along the line of centres with cos(cut) of the cue speed
+        phylib_real cut = phylib_dot_product(aim, dir);
+        if (cut < PHYLIB_SOLVE_MIN_COS) {
+            continue;
+        }
+
+        // both paths must be clear of other balls and of holes other than the chosen one
+        if (phylib_path_blocked(table, cue_pos, ghost, cue, ball)
+        || phylib_path_blocked(table, ball_pos, hole_pos, ball, slot)) {
+            continue;
+        }
+
+        // slowest cue speed for which the target still reaches the edge of the hole
+        phylib_real reach = hole_dist - PHYLIB_HOLE_RADIUS;
+        if (reach < 0.0) {
+            reach = 0.0;
+        }
+        phylib_real speed = phylib_sqrt(2.0 * PHYLIB_DRAG * cue_dist + 2.0 * PHYLIB_DRAG * reach / (cut * cut));
+        speed = speed * 1.1 + 10.0;
+
+        for (int attempt = 0; attempt < PHYLIB_SOLVE_ATTEMPTS && speed <= PHYLIB_SOLVE_MAX_SPEED; attempt++) {
+            phylib_coord vel = { aim.x * speed, aim.y * speed };
+            phylib_shot shot;
+            int outcome = phylib_try_pocket(table, target, &vel, &shot);
+            simulated++;
+
+            if (outcome == 1) {
+                // only count drops into one of the allowed holes
+                for (int k = 0; k < hole_count; k++) {
+                    if (holes[k] == shot.hole) {
+                        if (found < max_shots) {
+                            shots[found++] = shot;
+                        } else if (max_shots > 0 && shot.margin > shots[max_shots - 1].margin) {
+                            shots[max_shots - 1] = shot;
+                        }
+                        break;
+                    }
+                }
+                break;
+            }
+
+            // stopping short is the only failure more speed can fix
+            if (outcome != 0) {
+                break;
+            }
+            speed *= 1.3;
+        }
+
+        // keep the list ranked by margin
+        for (int i = found - 1; i > 0 && shots[i].margin > shots[i - 1].margin; i--) {
+            phylib_shot swap = shots[i];
+            shots[i] = shots[i - 1];
+            shots[i - 1] = swap;
+        }
+    }
+
+    if (simulations != NULL) {
+        *simulations = simulated;
+    }
+    return found;
+}
@@ -6,6 +6,9 @@
  * such as rolling balls, holes, cushions, etc. in a table environment.
  */
 
+#ifndef PHYLIB_H
+#define PHYLIB_H
+
 #define PHYLIB_BALL_RADIUS (28.5) // mm
 #define PHYLIB_BALL_DIAMETER (2*PHYLIB_BALL_RADIUS)
 #define PHYLIB_HOLE_RADIUS (2*PHYLIB_BALL_DIAMETER)
@@ -16,12 +19,54 @@
 #define PHYLIB_DRAG (150.0) // mm/s^2
 #define PHYLIB_MAX_TIME (600) // s
 #define PHYLIB_MAX_OBJECTS (26)
+#define PHYLIB_SOLVE_MIN_COS (0.17) // cos of the thinnest cut tried, about 80 degrees
+#define PHYLIB_SOLVE_ATTEMPTS (4)
+#define PHYLIB_SOLVE_MAX_SPEED (10000.0) // mm/s
+#define PHYLIB_GRAVITY (9810.0) // mm/s^2
+#define PHYLIB_SLIDE_FRICTION (0.2) // ball on cloth while the contact point slips
+#define PHYLIB_SPIN_FRICTION (0.044) // ball on cloth against side spin
+#define PHYLIB_CUSHION_FRICTION (0.2) // ball on cushion
 
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <stdio.h>
 
+// PHYLIB_SINGLE builds the float variant of the library; its functions get a phylibf_ prefix
+// so both variants can be linked into the same program
+#ifdef PHYLIB_SINGLE
+typedef float phylib_real;
+#define phylib_new_still_ball phylibf_new_still_ball
+#define phylib_new_rolling_ball phylibf_new_rolling_ball
+#define phylib_new_hole phylibf_new_hole
+#define phylib_new_hcushion phylibf_new_hcushion
+#define phylib_new_vcushion phylibf_new_vcushion
+#define phylib_new_table phylibf_new_table
+#define phylib_copy_object phylibf_copy_object
+#define phylib_copy_table phylibf_copy_table
+#define phylib_add_object phylibf_add_object
+#define phylib_free_table phylibf_free_table
+#define phylib_sub phylibf_sub
+#define phylib_length phylibf_length
+#define phylib_dot_product phylibf_dot_product
+#define phylib_distance phylibf_distance
+#define phylib_roll phylibf_roll
+#define phylib_stopped phylibf_stopped
+#define phylib_bounce phylibf_bounce
+#define phylib_rolling phylibf_rolling
+#define phylib_segment phylibf_segment
+#define phylib_segment_until phylibf_segment_until
+#define phylib_simulate phylibf_simulate
+#define phylib_object_string phylibf_object_string
+#define phylib_strike phylibf_strike
+#define phylib_try_pocket phylibf_try_pocket
+#define phylib_solve_pocket phylibf_solve_pocket
+#define phylib_enable_spin phylibf_enable_spin
+#define phylib_strike_spin phylibf_strike_spin
+#else
+typedef double phylib_real;
+#endif
+
 typedef enum {
 PHYLIB_STILL_BALL = 0,
 PHYLIB_ROLLING_BALL = 1,
@@ -31,8 +76,8 @@ PHYLIB_VCUSHION = 4,
 } phylib_obj;
 
 typedef struct {
-double x;
-double y;
+phylib_real x;
+phylib_real y;
 } phylib_coord;
 
 typedef struct {
@@ -52,11 +97,11 @@ phylib_coord acc;
 } phylib_rolling_ball;
 
 typedef struct {
-double y;
+phylib_real y;
 } phylib_hcushion;
 
 typedef struct {
-double x;
+phylib_real x;
 } phylib_vcushion;
 
 typedef union {
@@ -67,25 +112,56 @@ phylib_hcushion hcushion;
 phylib_vcushion vcushion;
 } phylib_untyped;
 
+typedef enum {
+PHYLIB_STOP_FIRST_CONTACT = 1,
+PHYLIB_STOP_BALL_POCKETED = 2,
+PHYLIB_STOP_CUE_POCKETED = 4,
+PHYLIB_STOP_ANY_POCKETED = 8,
+PHYLIB_STOP_TIME = 16,
+} phylib_stop_predicate;
+
 typedef struct {
 phylib_obj type;
 phylib_untyped obj;
 } phylib_object;
 
 typedef struct {
-double time;
+phylib_real x;
+phylib_real y;
+phylib_real z;
+} phylib_spin;
+
+typedef struct {
+phylib_real time;
 phylib_object * object[PHYLIB_MAX_OBJECTS];
+phylib_spin * spin; // angular velocity per object slot in rad/s, NULL for tables without spin
 } phylib_table;
 
+typedef struct {
+unsigned int predicates; // PHYLIB_STOP_* flags to watch
+unsigned char ball; // ball for PHYLIB_STOP_BALL_POCKETED
+phylib_real time; // simulated time for PHYLIB_STOP_TIME, counted from start
+phylib_real start; // table time the simulation started at, set by phylib_simulate
+unsigned int fired; // predicate that ended the simulation, 0 if every ball stopped
+int first_contact; // first ball touched by the cue ball, -1 if none; only recorded while negative
+unsigned int pocketed; // bit n is set once ball n drops
+} phylib_stop;
+
+typedef struct {
+unsigned char hole;
+phylib_coord vel;
+phylib_real margin;
+} phylib_shot;
+
 phylib_object *phylib_new_still_ball( unsigned char number, phylib_coord *pos );
 
 phylib_object *phylib_new_rolling_ball( unsigned char number, phylib_coord *pos, phylib_coord *vel, phylib_coord *acc );
 
 phylib_object *phylib_new_hole( phylib_coord *pos );
 
-phylib_object *phylib_new_hcushion( double y );
+phylib_object *phylib_new_hcushion( phylib_real y );
 
-phylib_object *phylib_new_vcushion( double x );
+phylib_object *phylib_new_vcushion( phylib_real x );
 
 phylib_table *phylib_new_table( void );
 
@@ -99,13 +175,13 @@ void phylib_free_table( phylib_table *table );
 
 phylib_coord phylib_sub( phylib_coord c1, phylib_coord c2 );
 
-double phylib_length( phylib_coord c );
+phylib_real phylib_length( phylib_coord c );
 
-double phylib_dot_product( phylib_coord a, phylib_coord b );
+phylib_real phylib_dot_product( phylib_coord a, phylib_coord b );
 
-double phylib_distance( phylib_object *obj1, phylib_object *obj2 );
+phylib_real phylib_distance( phylib_object *obj1, phylib_object *obj2 );
 
-void phylib_roll( phylib_object *new, phylib_object *old, double time );
+void phylib_roll( phylib_object *new, phylib_object *old, phylib_real time );
 
 unsigned char phylib_stopped( phylib_object *object );
 
@@ -115,8 +191,22 @@ unsigned char phylib_rolling( phylib_table *t );
 
 phylib_table *phylib_segment( phylib_table *table );
 
+phylib_table *phylib_segment_until( phylib_table *table, phylib_stop *stop );
+
+phylib_table *phylib_simulate( phylib_table *table, phylib_stop *stop );
+
 char *phylib_object_string( phylib_object *object );
 
+phylib_object *phylib_strike( phylib_table *table, unsigned char number, phylib_coord *vel );
+
+int phylib_enable_spin( phylib_table *table );
+
+phylib_object *phylib_strike_spin( phylib_table *table, unsigned char number, phylib_coord *vel,
+                                   phylib_real side, phylib_real height );
 
+int phylib_try_pocket( phylib_table *table, unsigned char target, phylib_coord *vel, phylib_shot *shot );
 
+int phylib_solve_pocket( phylib_table *table, unsigned char target, const unsigned char *holes, int hole_count,
+                         phylib_shot *shots, int max_shots, int *simulations );
 
+#endif
@@ -0,0 +1,123 @@
+/**
+ * @file phylib_kernel.h
+ * @brief Segment kernel template for the billiards physics simulation library.
+ *
+ * phylib.c includes this file twice: once with PHYLIB_KERNEL_SPIN set to 0 for tables without
+ * spin, and once with it set to 1 for tables with a spin array. The spin code is removed by the
+ * preprocessor from the first copy, so tables without spin run the original rolling kernel.
+ * PHYLIB_KERNEL(name) gives each copy its own function name. There is deliberately no include guard.
+ */
+
+/**
+ * Simulates the physics of the table for a small time segment, ending at the next collision,
+ * stopping ball or time predicate. See phylib_segment_until.
+ *
+ * @param table A pointer to the table object to be simulated, with at least one rolling ball.
+ * @param stop  A pointer to the stop request, or NULL.
+ * @return      A pointer to a new table object representing the state after simulation.
+ */
+static phylib_table *PHYLIB_KERNEL(phylib_segment)(phylib_table *table, phylib_stop *stop) {
+
+    // initalize time to the sim rate, later steps are counted so float builds do not accumulate rounding
+    int step = 1;
+    phylib_real time = PHYLIB_R(PHYLIB_SIM_RATE);
+
+    // the time predicate becomes a single comparison per step
+    phylib_real limit = HUGE_VAL;
+    if (stop != NULL && (stop->predicates & PHYLIB_STOP_TIME)) {
+        limit = stop->start + stop->time;
+    }
+
+    // copy table from the table provided
+    phylib_table * new_table = phylib_copy_table(table);
+
+#if PHYLIB_KERNEL_SPIN
+    // the sliding and rolling phases of every ball are known for the whole segment
+    phylib_motion motion[PHYLIB_MAX_OBJECTS];
+    for (int i = 10; i < PHYLIB_MAX_OBJECTS; i++) {
+        phylib_motion_start(&motion[i], table->object[i], &table->spin[i]);
+    }
+#endif
+
+    // loop over time
+    while (new_table->time < PHYLIB_MAX_TIME) {
+
+        // loop over balls
+        for (int i = 10; i < PHYLIB_MAX_OBJECTS; i++) {
+            // roll out every ball
+            if (new_table->object[i] != NULL && new_table->object[i]->type == PHYLIB_ROLLING_BALL) {
+#if PHYLIB_KERNEL_SPIN
+                phylib_motion_roll(new_table->object[i], &motion[i], time);
+#else
+                phylib_roll(new_table->object[i], table->object[i], time);
+#endif
+            }
+
+        }
+
+            // loop over all objects
+            for (int i = 10; i < PHYLIB_MAX_OBJECTS; i++) {
+
+                for (int j = 0; j < PHYLIB_MAX_OBJECTS; j++) {
+                    if (new_table->object[j] != NULL && j != i) {
+
+                        // check if 2 objects are close enough for collision
+                        if (phylib_distance(new_table->object[i], new_table->object[j]) < 0.0
+                        && phylib_distance(new_table->object[i], new_table->object[j]) != -1
+                        && phylib_approaching(new_table->object[i], new_table->object[j])) {
+
+                            // let the stop request see the collision before it is resolved
+                            if (stop != NULL) {
+                                phylib_stop_event(stop, new_table->object[i], new_table->object[j]);
+                            }
+
+                            // do collision measures
+#if PHYLIB_KERNEL_SPIN
+                            phylib_motion_spin(new_table, motion, time);
+                            phylib_bounce_spin(new_table, i, j);
+#else
+                            phylib_bounce(&(new_table->object[i]), &(new_table->object[j]));
+#endif
+                            new_table->time += time;
+                            return new_table;
+                        }
+                    }
+
+                }
+
+#if PHYLIB_KERNEL_SPIN
+                // a sliding ball can pass through zero speed, for example when draw pulls it back
+                if (time >= motion[i].slide && phylib_stopped(new_table->object[i]) == 1) {
+                    phylib_motion_spin(new_table, motion, time);
+                    memset(&new_table->spin[i], 0, sizeof(phylib_spin));
+                    new_table->time += time;
+                    return new_table;
+                }
+#else
+                if (phylib_stopped(new_table->object[i]) == 1) {
+                    new_table->time += time;
+                    return new_table;
+                }
+#endif
+
+        }
+
+        // end the segment where the time predicate fires
+        if (table->time + time >= limit) {
+            stop->fired = PHYLIB_STOP_TIME;
+#if PHYLIB_KERNEL_SPIN
+            phylib_motion_spin(new_table, motion, time);
+#endif
+            new_table->time += time;
+            return new_table;
+        }
+
+        step++;
+        time = PHYLIB_R(step * PHYLIB_SIM_RATE);
+    }
+#if PHYLIB_KERNEL_SPIN
+    phylib_motion_spin(new_table, motion, time);
+#endif
+    new_table->time += time;
+    return new_table;
+}
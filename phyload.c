@@ -0,0 +1,501 @@
+/**
+ * @file phyload.c
+ * @brief Load generator for the billiards simulator HTTP servers.
+ *
+ * This program keeps a fixed number of connections busy against a server for a fixed time
+ * and reports requests per second and latency percentiles. It works against both physerver
+ * and server.py; the latter closes the connection after every response, in which case the
+ * generator reconnects and counts the connect time as part of the request latency.
+ *
+ * Spectators can be added with -w: each one subscribes to /watch on physerver and drains the
+ * event stream, so the cost of fanning shots out can be measured. With -P the CPU time the
+ * server process used during the run is read from /proc and reported per request, split into
+ * user time spent in the server itself and system time spent in the kernel, mostly copying
+ * responses and events into sockets.
+ *
+ * Usage: phyload [-p port] [-c connections] [-d seconds] [-m shoot|start|static] [-v speed]
+ *                [-w spectators] [-P server_pid]
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <strings.h>
+
+#include "phyweb.h"
+
+#define PHYLOAD_MAX_EVENTS (256)
+
+typedef struct {
+int fd;
+phyweb_buf request;
+size_t sent;
+phyweb_buf response;
+double started;
+} phyload_conn;
+
+typedef struct {
+int fd;
+unsigned long events;
+unsigned long bytes;
+char last;
+} phyload_viewer;
+
+typedef struct {
+double *data;
+size_t len;
+size_t cap;
+} phyload_samples;
+
+/**
+ * Returns a monotonic timestamp in seconds.
+ *
+ * @return The current time.
+ */
+static double phyload_now(void) {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Records a latency sample.
+ *
+ * @param samples A pointer to the sample array.
+ * @param value   The latency in seconds.
+ */
+static void phyload_record(phyload_samples *samples, double value) {
+
+    if (samples->len == samples->cap) {
+        size_t cap = samples->cap ? samples->cap * 2 : 4096;
+        double *data = (double *)realloc(samples->data, cap * sizeof(double));
+        if (data == NULL) {
+            return;
+        }
+        samples->data = data;
+        samples->cap = cap;
+    }
+    samples->data[samples->len++] = value;
+}
+
+/**
+ * Comparison function used to sort latency samples.
+ */
+static int phyload_compare(const void *a, const void *b) {
+
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Returns a percentile of sorted samples, in milliseconds.
+ *
+ * @param samples A pointer to the sorted sample array.
+ * @param p       The percentile between 0 and 100.
+ * @return        The latency at that percentile.
+ */
+static double phyload_percentile(phyload_samples *samples, double p) {
+
+    if (samples->len == 0) {
+        return 0.0;
+    }
+    size_t index = (size_t)(p / 100.0 * (samples->len - 1) + 0.5);
+    return samples->data[index] * 1000.0;
+}
+
+/**
+ * Builds the next request for a connection according to the selected mode.
+ *
+ * @param conn  A pointer to the connection.
+ * @param mode  The request mode.
+ * @param speed The cue ball speed used for shots.
+ */
+static void phyload_request(phyload_conn *conn, const char *mode, double speed) {
+
+    phyweb_buf body = { NULL, 0, 0 };
+    conn->request.len = 0;
+    conn->sent = 0;
+
+    if (strcmp(mode, "static") == 0) {
+        phyweb_buf_printf(&conn->request, "GET /game.js HTTP/1.1\r\nHost: localhost\r\n\r\n");
+        return;
+    }
+
+    if (strcmp(mode, "start") == 0) {
+        phyweb_buf_printf(&body, "player1name=alice&player2name=bob");
+    } else {
+        // aim in a random direction so shots vary in length
+        double angle = ((double)rand() / RAND_MAX) * 2.0 * M_PI;
+        phyweb_buf_printf(&body, "velX=%.3f&velY=%.3f", speed * cos(angle), speed * sin(angle));
+    }
+
+    phyweb_buf_printf(&conn->request,
+        "POST /%s HTTP/1.1\r\nHost: localhost\r\n"
+        "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: %lu\r\n\r\n%s",
+        strcmp(mode, "start") == 0 ? "start" : "shoot", (unsigned long)body.len, body.data);
+    phyweb_buf_free(&body);
+}
+
+/**
+ * Opens a non-blocking connection to the server and registers it with epoll.
+ *
+ * @param epfd The epoll descriptor.
+ * @param conn A pointer to the connection.
+ * @param addr The server address.
+ * @return     0 on success, or -1 on failure.
+ */
+static int phyload_connect(int epfd, phyload_conn *conn, struct sockaddr_in *addr) {
+
+    conn->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (conn->fd < 0) {
+        return -1;
+    }
+
+    int on = 1;
+    setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    if (connect(conn->fd, (struct sockaddr *)addr, sizeof(*addr)) != 0 && errno != EINPROGRESS) {
+        close(conn->fd);
+        conn->fd = -1;
+        return -1;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLOUT | EPOLLIN;
+    ev.data.ptr = conn;
+    return epoll_ctl(epfd, EPOLL_CTL_ADD, conn->fd, &ev);
+}
+
+/**
+ * Checks whether the response buffer holds one complete response.
+ *
+ * @param conn   A pointer to the connection.
+ * @param eof    Non-zero if the server closed the connection.
+ * @param closes Set to non-zero if the server will close the connection after this response.
+ * @return       1 if the response is complete, otherwise 0.
+ */
+static int phyload_complete(phyload_conn *conn, int eof, int *closes) {
+
+    if (conn->response.len == 0) {
+        return 0;
+    }
+
+    char *end = strstr(conn->response.data, "\r\n\r\n");
+    if (end == NULL) {
+        return 0;
+    }
+    *end = '\0';
+
+    // HTTP/1.0 servers such as BaseHTTPRequestHandler close after each response
+    *closes = strncmp(conn->response.data, "HTTP/1.0", 8) == 0 || strcasestr(conn->response.data, "Connection: close") != NULL;
+
+    char *length = strcasestr(conn->response.data, "Content-length:");
+    size_t head_len = (size_t)(end - conn->response.data) + 4;
+    *end = '\r';
+
+    if (length == NULL) {
+        return eof;
+    }
+    return conn->response.len >= head_len + strtoul(length + 15, NULL, 10);
+}
+
+/**
+ * Opens a spectator connection subscribed to /watch and registers it with epoll.
+ *
+ * @param epfd   The epoll descriptor.
+ * @param viewer A pointer to the spectator.
+ * @param addr   The server address.
+ * @return       0 on success, or -1 on failure.
+ */
+static int phyload_watch(int epfd, phyload_viewer *viewer, struct sockaddr_in *addr) {
+
+    static const char request[] = "GET /watch HTTP/1.1\r\nHost: localhost\r\nAccept: text/event-stream\r\n\r\n";
+
+    // connect and subscribe while still blocking, then drain without blocking
+    viewer->fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (viewer->fd < 0 || connect(viewer->fd, (struct sockaddr *)addr, sizeof(*addr)) != 0
+    || send(viewer->fd, request, sizeof(request) - 1, MSG_NOSIGNAL) != (ssize_t)(sizeof(request) - 1)) {
+        return -1;
+    }
+    fcntl(viewer->fd, F_SETFL, fcntl(viewer->fd, F_GETFL) | O_NONBLOCK);
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = viewer;
+    return epoll_ctl(epfd, EPOLL_CTL_ADD, viewer->fd, &ev);
+}
+
+/**
+ * Reads everything available on a spectator connection, counting events by their blank line.
+ *
+ * @param viewer A pointer to the spectator.
+ */
+static void phyload_drain(phyload_viewer *viewer) {
+
+    char chunk[65536];
+    ssize_t got;
+    while ((got = recv(viewer->fd, chunk, sizeof(chunk), 0)) > 0) {
+        viewer->bytes += (unsigned long)got;
+        for (ssize_t i = 0; i < got; i++) {
+            if (chunk[i] == '\n' && viewer->last == '\n') {
+                viewer->events++;
+            }
+            viewer->last = chunk[i];
+        }
+    }
+}
+
+/**
+ * Returns the CPU time used so far by a process, from /proc.
+ *
+ * @param pid    The process id.
+ * @param user   A pointer receiving the user time in seconds.
+ * @param system A pointer receiving the system time in seconds.
+ * @return       0 on success, or -1 if it cannot be read.
+ */
+static int phyload_cpu(int pid, double *user, double *system) {
+
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        return -1;
+    }
+
+    // utime and stime are fields 14 and 15, after the parenthesised command name
+    char line[1024];
+    int result = -1;
+    if (fgets(line, sizeof(line), fp) != NULL) {
+        char *rest = strrchr(line, ')');
+        unsigned long utime, stime;
+        if (rest != NULL && sscanf(rest + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) == 2) {
+            *user = (double)utime / sysconf(_SC_CLK_TCK);
+            *system = (double)stime / sysconf(_SC_CLK_TCK);
+            result = 0;
+        }
+    }
+    fclose(fp);
+    return result;
+}
+
+int main(int argc, char **argv) {
+
+    int port = 8000;
+    int connections = 8;
+    double duration = 10.0;
+    const char *mode = "shoot";
+    double speed = 1000.0;
+    int spectators = 0;
+    int server_pid = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:c:d:m:v:w:P:")) != -1) {
+        switch (opt) {
+            case 'p': port = atoi(optarg); break;
+            case 'c': connections = atoi(optarg); break;
+            case 'd': duration = atof(optarg); break;
+            case 'm': mode = optarg; break;
+            case 'v': speed = atof(optarg); break;
+            case 'w': spectators = atoi(optarg); break;
+            case 'P': server_pid = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-p port] [-c connections] [-d seconds] [-m shoot|start|static] [-v speed]"
+                    " [-w spectators] [-P server_pid]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (connections < 1) {
+        connections = 1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((unsigned short)port);
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    phyload_conn *conns = (phyload_conn *)calloc((size_t)connections, sizeof(phyload_conn));
+    if (epfd < 0 || conns == NULL) {
+        perror("phyload");
+        return 1;
+    }
+
+    phyload_viewer *viewers = (phyload_viewer *)calloc((size_t)(spectators > 0 ? spectators : 1), sizeof(phyload_viewer));
+    for (int i = 0; i < spectators; i++) {
+        if (phyload_watch(epfd, &viewers[i], &addr) != 0) {
+            perror("watch");
+            return 1;
+        }
+    }
+
+    phyload_samples samples = { NULL, 0, 0 };
+    unsigned long errors = 0;
+    unsigned long reconnects = 0;
+    double user_start = 0.0;
+    double system_start = 0.0;
+    int measured = server_pid > 0 && phyload_cpu(server_pid, &user_start, &system_start) == 0;
+    double start = phyload_now();
+    double deadline = start + duration;
+
+    for (int i = 0; i < connections; i++) {
+        phyload_request(&conns[i], mode, speed);
+        conns[i].started = phyload_now();
+        if (phyload_connect(epfd, &conns[i], &addr) != 0) {
+            perror("connect");
+            return 1;
+        }
+    }
+
+    struct epoll_event events[PHYLOAD_MAX_EVENTS];
+    while (phyload_now() < deadline) {
+        int n = epoll_wait(epfd, events, PHYLOAD_MAX_EVENTS, 100);
+        for (int e = 0; e < n; e++) {
+            // spectators only need draining
+            phyload_viewer *viewer = (phyload_viewer *)events[e].data.ptr;
+            if (viewer >= viewers && viewer < viewers + spectators) {
+                phyload_drain(viewer);
+                continue;
+            }
+
+            phyload_conn *conn = (phyload_conn *)events[e].data.ptr;
+            int eof = 0;
+            int failed = 0;
+
+            // write whatever is left of the request
+            if ((events[e].events & EPOLLOUT) && conn->sent < conn->request.len) {
+                ssize_t sent = send(conn->fd, conn->request.data + conn->sent, conn->request.len - conn->sent, MSG_NOSIGNAL);
+                if (sent < 0 && errno != EAGAIN) {
+                    failed = 1;
+                } else if (sent > 0) {
+                    conn->sent += (size_t)sent;
+                }
+                if (conn->sent == conn->request.len) {
+                    struct epoll_event ev;
+                    ev.events = EPOLLIN;
+                    ev.data.ptr = conn;
+                    epoll_ctl(epfd, EPOLL_CTL_MOD, conn->fd, &ev);
+                }
+            }
+
+            // read the response
+            if (!failed && (events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) {
+                for (;;) {
+                    if (phyweb_buf_reserve(&conn->response, 65536) != 0) {
+                        failed = 1;
+                        break;
+                    }
+                    ssize_t got = recv(conn->fd, conn->response.data + conn->response.len,
+                        conn->response.cap - conn->response.len - 1, 0);
+                    if (got > 0) {
+                        conn->response.len += (size_t)got;
+                        conn->response.data[conn->response.len] = '\0';
+                    } else if (got == 0) {
+                        eof = 1;
+                        break;
+                    } else {
+                        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                            failed = 1;
+                        }
+                        break;
+                    }
+                }
+            }
+
+            int closes = 0;
+            if (!failed && phyload_complete(conn, eof, &closes)) {
+                phyload_record(&samples, phyload_now() - conn->started);
+                conn->response.len = 0;
+                phyload_request(conn, mode, speed);
+                conn->started = phyload_now();
+
+                if (closes || eof) {
+                    epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+                    close(conn->fd);
+                    reconnects++;
+                    if (phyload_connect(epfd, conn, &addr) != 0) {
+                        failed = 1;
+                    }
+                } else {
+                    struct epoll_event ev;
+                    ev.events = EPOLLIN | EPOLLOUT;
+                    ev.data.ptr = conn;
+                    epoll_ctl(epfd, EPOLL_CTL_MOD, conn->fd, &ev);
+                }
+            } else if (!failed && eof) {
+                failed = 1;
+            }
+
+            // start over on a fresh connection after an error
+            if (failed) {
+                errors++;
+                if (conn->fd >= 0) {
+                    epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+                    close(conn->fd);
+                }
+                conn->response.len = 0;
+                phyload_request(conn, mode, speed);
+                conn->started = phyload_now();
+                if (phyload_connect(epfd, conn, &addr) != 0) {
+                    conn->fd = -1;
+                }
+            }
+        }
+    }
+
+    double elapsed = phyload_now() - start;
+    double user = 0.0;
+    double system = 0.0;
+    measured = measured && phyload_cpu(server_pid, &user, &system) == 0;
+    user -= user_start;
+    system -= system_start;
+    qsort(samples.data, samples.len, sizeof(double), phyload_compare);
+
+    printf("port %d, mode %s, %d connections, %.1f s\n", port, mode, connections, elapsed);
+    printf("  requests   %lu (%lu errors, %lu reconnects)\n", (unsigned long)samples.len, errors, reconnects);
+    printf("  throughput %.1f req/s\n", samples.len / elapsed);
+    printf("  latency    p50 %.2f ms  p90 %.2f ms  p99 %.2f ms  p99.9 %.2f ms  max %.2f ms\n",
+        phyload_percentile(&samples, 50.0), phyload_percentile(&samples, 90.0),
+        phyload_percentile(&samples, 99.0), phyload_percentile(&samples, 99.9),
+        phyload_percentile(&samples, 100.0));
+
+    if (spectators > 0) {
+        unsigned long events = 0;
+        unsigned long bytes = 0;
+        for (int i = 0; i < spectators; i++) {
+            events += viewers[i].events;
+            bytes += viewers[i].bytes;
+            close(viewers[i].fd);
+        }
+        printf("  spectators %d, %.1f events and %.1f MB each\n", spectators,
+            (double)events / spectators, bytes / 1e6 / spectators);
+    }
+    if (measured) {
+        double per = samples.len ? 1000.0 / samples.len : 0.0;
+        printf("  server cpu %.1f%% of one core, %.3f ms per request (%.3f user, %.3f system)\n",
+            100.0 * (user + system) / elapsed, (user + system) * per, user * per, system * per);
+    }
+
+    for (int i = 0; i < connections; i++) {
+        if (conns[i].fd >= 0) {
+            close(conns[i].fd);
+        }
+        phyweb_buf_free(&conns[i].request);
+        phyweb_buf_free(&conns[i].response);
+    }
+    free(conns);
+    free(viewers);
+    free(samples.data);
+    close(epfd);
+    return 0;
+}
@@ -0,0 +1,219 @@
+/**
+ * @file phyplay.c
+ * @brief Headless self-play driver for the native eight-ball rules layer.
+ *
+ * This program plays complete games between two shot policies on a pool of threads and reports
+ * games per second, shots per game and where the time goes (racking, choosing shots, simulating,
+ * applying rules). Game n is always seeded with n + 1, so results do not depend on the thread count.
+ *
+ * With -r the same batch of games is played several times and the resident set size is printed
+ * after every round; a size that keeps growing between rounds points at a leak in the library.
+ *
+ * Usage: phyplay [-g games] [-t threads] [-p random|greedy|mixed] [-r rounds]
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "phygame.h"
+
+typedef struct {
+int games;
+int errors;
+int shots;
+int fouls;
+int wins[2];
+int draws;
+double phase_time[PHYGAME_PHASES]; // s
+} phyplay_stats;
+
+typedef struct {
+pthread_mutex_t lock;
+int next;
+int games;
+phygame_policy policy[2];
+} phyplay_queue;
+
+typedef struct {
+pthread_t thread;
+phyplay_queue *queue;
+phyplay_stats stats;
+} phyplay_worker;
+
+static const char *phyplay_phase_names[PHYGAME_PHASES] = { "rack", "policy", "simulate", "rules" };
+
+/**
+ * Returns a monotonic timestamp in seconds.
+ *
+ * @return The current time.
+ */
+static double phyplay_now(void) {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Returns the resident set size of this process, from /proc.
+ *
+ * @return The resident set size in KiB, or -1 if it cannot be read.
+ */
+static long phyplay_rss(void) {
+
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if (fp == NULL) {
+        return -1;
+    }
+    long size, resident;
+    long result = -1;
+    if (fscanf(fp, "%ld %ld", &size, &resident) == 2) {
+        result = resident * (sysconf(_SC_PAGESIZE) / 1024);
+    }
+    fclose(fp);
+    return result;
+}
+
+/**
+ * Worker thread: takes game numbers off the queue and plays each game to the end.
+ *
+ * @param arg A pointer to the worker.
+ * @return    NULL.
+ */
+static void *phyplay_work(void *arg) {
+
+    phyplay_worker *worker = (phyplay_worker *)arg;
+    phyplay_queue *queue = worker->queue;
+
+    for (;;) {
+        pthread_mutex_lock(&queue->lock);
+        int n = queue->next < queue->games ? queue->next++ : -1;
+        pthread_mutex_unlock(&queue->lock);
+        if (n < 0) {
+            break;
+        }
+
+        phygame *game = phygame_new((unsigned int)n + 1, queue->policy[0], queue->policy[1]);
+        int winner = phygame_play(game);
+        if (game == NULL || winner == -1) {
+            worker->stats.errors++;
+            phygame_free(game);
+            continue;
+        }
+
+        worker->stats.games++;
+        worker->stats.shots += game->shots;
+        worker->stats.fouls += game->fouls;
+        if (winner == -2) {
+            worker->stats.draws++;
+        } else {
+            worker->stats.wins[winner]++;
+        }
+        for (int p = 0; p < PHYGAME_PHASES; p++) {
+            worker->stats.phase_time[p] += game->phase_time[p];
+        }
+        phygame_free(game);
+    }
+
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+
+    int games = 100;
+    int threads = 4;
+    const char *policy = "greedy";
+    int rounds = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "g:t:p:r:")) != -1) {
+        switch (opt) {
+            case 'g': games = atoi(optarg); break;
+            case 't': threads = atoi(optarg); break;
+            case 'p': policy = optarg; break;
+            case 'r': rounds = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-g games] [-t threads] [-p random|greedy|mixed] [-r rounds]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    phyplay_queue queue;
+    pthread_mutex_init(&queue.lock, NULL);
+    queue.games = games;
+    if (strcmp(policy, "random") == 0) {
+        queue.policy[0] = queue.policy[1] = phygame_random_policy;
+    } else if (strcmp(policy, "mixed") == 0) {
+        queue.policy[0] = phygame_greedy_policy;
+        queue.policy[1] = phygame_random_policy;
+    } else {
+        queue.policy[0] = queue.policy[1] = phygame_greedy_policy;
+    }
+
+    phyplay_worker *workers = (phyplay_worker *)calloc((size_t)threads, sizeof(phyplay_worker));
+    if (workers == NULL) {
+        perror("phyplay");
+        return 1;
+    }
+
+    printf("%d games per round, %d threads, %s policy\n", games, threads, policy);
+    printf("rss before: %ld KiB\n", phyplay_rss());
+
+    for (int round = 0; round < rounds; round++) {
+        queue.next = 0;
+        memset(workers, 0, (size_t)threads * sizeof(phyplay_worker));
+
+        double start = phyplay_now();
+        for (int i = 0; i < threads; i++) {
+            workers[i].queue = &queue;
+            if (pthread_create(&workers[i].thread, NULL, phyplay_work, &workers[i]) != 0) {
+                perror("phyplay");
+                return 1;
+            }
+        }
+        phyplay_stats total;
+        memset(&total, 0, sizeof(total));
+        for (int i = 0; i < threads; i++) {
+            pthread_join(workers[i].thread, NULL);
+            total.games += workers[i].stats.games;
+            total.errors += workers[i].stats.errors;
+            total.shots += workers[i].stats.shots;
+            total.fouls += workers[i].stats.fouls;
+            total.wins[0] += workers[i].stats.wins[0];
+            total.wins[1] += workers[i].stats.wins[1];
+            total.draws += workers[i].stats.draws;
+            for (int p = 0; p < PHYGAME_PHASES; p++) {
+                total.phase_time[p] += workers[i].stats.phase_time[p];
+            }
+        }
+        double elapsed = phyplay_now() - start;
+
+        printf("round %d: %d games in %.2f s, %.2f games/s, %.1f shots/game, %.1f fouls/game,"
+            " wins %d/%d, draws %d, errors %d, rss %ld KiB\n",
+            round + 1, total.games, elapsed, total.games / elapsed,
+            total.games ? (double)total.shots / total.games : 0.0,
+            total.games ? (double)total.fouls / total.games : 0.0,
+            total.wins[0], total.wins[1], total.draws, total.errors, phyplay_rss());
+
+        // thread time per phase, so the split does not depend on how many threads ran
+        double busy = 0.0;
+        for (int p = 0; p < PHYGAME_PHASES; p++) {
+            busy += total.phase_time[p];
+        }
+        for (int p = 0; p < PHYGAME_PHASES; p++) {
+            printf("  %-9s %9.3f ms/game %6.2f%%\n", phyplay_phase_names[p],
+                total.games ? total.phase_time[p] * 1e3 / total.games : 0.0,
+                busy > 0.0 ? total.phase_time[p] * 100.0 / busy : 0.0);
+        }
+    }
+
+    free(workers);
+    pthread_mutex_destroy(&queue.lock);
+    return 0;
+}
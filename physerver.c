@@ -0,0 +1,1031 @@
+/**
+ * @file physerver.c
+ * @brief Native HTTP front end for the billiards simulator.
+ *
+ * This server answers the same requests as server.py (/index.html, /game.js, /start and /shoot)
+ * but links libphylib directly. Connections are handled by a single epoll event loop, static
+ * files are cached in memory with their headers, and /start and /shoot are handed to a pool
+ * of worker threads so a long shot never blocks other clients. Shots on the shared game are
+ * played one at a time, in the order the workers pick them up; new racks and static files are
+ * still prepared in parallel.
+ *
+ * Spectators subscribe to /watch, a server-sent event stream. Every shot is encoded into an
+ * event once, by the worker that simulated it, and the event loop queues a reference to that
+ * same buffer on every subscriber. A subscriber that falls more than PHYSERVER_MAX_FEED events
+ * behind loses the oldest unsent ones, since only the latest table matters to a viewer.
+ *
+ * Usage: physerver [port] [workers]
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <strings.h>
+
+#include "phyweb.h"
+
+#define PHYSERVER_PORT (8000)
+#define PHYSERVER_WORKERS (4)
+#define PHYSERVER_MAX_EVENTS (128)
+#define PHYSERVER_MAX_REQUEST (1 << 20) // bytes
+#define PHYSERVER_MAX_FEED (4) // events queued per spectator
+
+typedef enum {
+PHYSERVER_JOB_START = 0,
+PHYSERVER_JOB_SHOOT = 1,
+} physerver_job_kind;
+
+typedef struct physerver_conn physerver_conn;
+
+typedef struct physerver_job {
+physerver_job_kind kind;
+physerver_conn *conn;
+char *body;
+size_t body_len;
+int keep_alive;
+phyweb_buf response;
+phyweb_shared *broadcast;
+phyweb_shared *latest;
+struct physerver_job *next;
+} physerver_job;
+
+typedef struct physerver_feed {
+phyweb_shared *event;
+struct physerver_feed *next;
+} physerver_feed;
+
+struct physerver_conn {
+int fd;
+phyweb_buf in;
+phyweb_buf out;
+const char *static_out;
+size_t out_len;
+size_t out_pos;
+int keep_alive;
+int busy;
+int closed;
+int subscriber;
+physerver_feed *feed;
+physerver_feed *feed_tail;
+int feed_len;
+size_t feed_pos;
+physerver_conn *prev_sub;
+physerver_conn *next_sub;
+};
+
+typedef struct {
+physerver_job *head;
+physerver_job *tail;
+pthread_mutex_t lock;
+pthread_cond_t ready;
+} physerver_queue;
+
+typedef struct {
+phyweb_buf response;
+} physerver_static;
+
+// addresses used to tell the listener and the completion eventfd apart in epoll
+static char physerver_listener_tag;
+static char physerver_done_tag;
+
+static volatile sig_atomic_t physerver_stop = 0;
+
+static physerver_queue physerver_pending = { NULL, NULL, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+static physerver_queue physerver_done = { NULL, NULL, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER };
+static int physerver_done_fd = -1;
+
+// the current game, shared by all connections just like table_id in server.py; the lock is
+// held for the whole of a shot, so concurrent shots queue up instead of overwriting each other
+static phylib_table *physerver_table = NULL;
+static pthread_mutex_t physerver_table_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static physerver_static physerver_index;
+static physerver_static physerver_script;
+
+// spectators and the event describing the current table, only touched by the event loop
+static physerver_conn *physerver_subscribers = NULL;
+static phyweb_shared *physerver_latest = NULL;
+static unsigned long physerver_dropped = 0;
+
+/**
+ * Pushes a job on the back of a queue.
+ *
+ * @param queue A pointer to the queue.
+ * @param job   A pointer to the job.
+ */
+static void physerver_push(physerver_queue *queue, physerver_job *job) {
+
+    job->next = NULL;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->tail == NULL) {
+        queue->head = job;
+    } else {
+        queue->tail->next = job;
+    }
+    queue->tail = job;
+    pthread_cond_signal(&queue->ready);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * Removes every job from a queue at once.
+ *
+ * @param queue A pointer to the queue.
+ * @return      The list of jobs in queue order, or NULL if it was empty.
+ */
+static physerver_job *physerver_drain(physerver_queue *queue) {
+
+    pthread_mutex_lock(&queue->lock);
+    physerver_job *jobs = queue->head;
+    queue->head = NULL;
+    queue->tail = NULL;
+    pthread_mutex_unlock(&queue->lock);
+    return jobs;
+}
+
+/**
+ * Appends the status line and headers of a response.
+ *
+ * @param buf          A pointer to the buffer.
+ * @param status       The status line text, such as "200 OK".
+ * @param content_type The content type, or NULL to leave it out.
+ * @param length       The length of the body.
+ * @param keep_alive   Non-zero if the connection stays open after the response.
+ * @return             0 on success, or -1 if memory allocation fails.
+ */
+static int physerver_headers(phyweb_buf *buf, const char *status, const char *content_type, size_t length, int keep_alive) {
+
+    if (phyweb_buf_printf(buf, "HTTP/1.1 %s\r\nServer: physerver\r\n", status) != 0) {
+        return -1;
+    }
+    if (content_type != NULL && phyweb_buf_printf(buf, "Content-type: %s\r\n", content_type) != 0) {
+        return -1;
+    }
+    return phyweb_buf_printf(buf, "Content-length: %lu\r\nConnection: %s\r\n\r\n",
+        (unsigned long)length, keep_alive ? "keep-alive" : "close");
+}
+
+/**
+ * Loads a file from disk and caches it together with its response headers.
+ *
+ * @param cache        A pointer to the cache entry.
+ * @param path         The path of the file.
+ * @param content_type The content type to announce.
+ * @return             0 on success, or -1 if the file cannot be read.
+ */
+static int physerver_load(physerver_static *cache, const char *path, const char *content_type) {
+
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return -1;
+    }
+
+    phyweb_buf body = { NULL, 0, 0 };
+    char chunk[4096];
+    size_t got;
+    while ((got = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+        if (phyweb_buf_append(&body, chunk, got) != 0) {
+            fclose(fp);
+            phyweb_buf_free(&body);
+            return -1;
+        }
+    }
+    fclose(fp);
+
+    // static files are always served keep-alive, the loop closes when the client asked for it
+    if (physerver_headers(&cache->response, "200 OK", content_type, body.len, 1) != 0
+    || phyweb_buf_append(&cache->response, body.data ? body.data : "", body.len) != 0) {
+        phyweb_buf_free(&body);
+        return -1;
+    }
+    phyweb_buf_free(&body);
+    return 0;
+}
+
+/**
+ * Builds the full response of a job from its body.
+ *
+ * @param job          A pointer to the job.
+ * @param body         A pointer to the response body.
+ * @param content_type The content type of the body.
+ * @param failed       Non-zero if the job failed, in which case the body is ignored.
+ * @return             0 if the full response was built, or -1 if the client gets an error or nothing.
+ */
+static int physerver_respond(physerver_job *job, phyweb_buf *body, const char *content_type, int failed) {
+
+    if (failed) {
+        job->response.len = 0;
+        physerver_headers(&job->response, "500 Internal Server Error", NULL, 0, 0);
+        job->keep_alive = 0;
+        return -1;
+    }
+    if (physerver_headers(&job->response, "200 OK", content_type, body->len, job->keep_alive) != 0
+    || phyweb_buf_append(&job->response, body->data ? body->data : "", body->len) != 0) {
+        phyweb_buf_free(&job->response);
+        job->keep_alive = 0;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Hands a finished job back to the event loop and wakes it so it can start writing the response.
+ *
+ * @param job A pointer to the job.
+ */
+static void physerver_hand_back(physerver_job *job) {
+
+    uint64_t one = 1;
+
+    physerver_push(&physerver_done, job);
+    if (write(physerver_done_fd, &one, sizeof(one)) < 0) {
+        perror("write");
+    }
+}
+
+/**
+ * Runs a /start or /shoot job, builds its full response and hands it back to the event loop.
+ *
+ * Jobs that change the game are handed back while physerver_table_lock is still held, so the
+ * event loop sees them, and spectators get their events, in the order they changed the game.
+ *
+ * @param job A pointer to the job.
+ */
+static void physerver_run(physerver_job *job) {
+
+    phyweb_buf body = { NULL, 0, 0 };
+
+    if (job->kind == PHYSERVER_JOB_START) {
+        char player1[PHYWEB_MAX_NAME];
+        char player2[PHYWEB_MAX_NAME];
+        phyweb_form_value(job->body, job->body_len, "player1name", player1, sizeof(player1));
+        phyweb_form_value(job->body, job->body_len, "player2name", player2, sizeof(player2));
+
+        // racking and rendering do not touch the game, so new games are set up in parallel
+        phylib_table *rack = phyweb_new_rack();
+        int failed = rack == NULL || phyweb_start_page(&body, rack, player1, player2) != 0;
+        failed = physerver_respond(job, &body, "text/html", failed) != 0;
+        phyweb_buf_free(&body);
+
+        // the game only changes when the client gets its start page
+        if (failed) {
+            physerver_hand_back(job);
+            phylib_free_table(rack);
+            return;
+        }
+
+        // spectators get the new table
+        phyweb_buf svg = { NULL, 0, 0 };
+        if (phyweb_table_svg(&svg, rack) == 0) {
+            job->latest = phyweb_event("table", svg.data, svg.len);
+            if (job->latest != NULL) {
+                job->broadcast = phyweb_retain(job->latest);
+            }
+        }
+        phyweb_buf_free(&svg);
+
+        pthread_mutex_lock(&physerver_table_lock);
+        phylib_table *old = physerver_table;
+        physerver_table = rack;
+        physerver_hand_back(job);
+        pthread_mutex_unlock(&physerver_table_lock);
+        phylib_free_table(old);
+        return;
+    }
+
+    char value[64];
+    double vel_x = 0.0;
+    double vel_y = 0.0;
+    if (phyweb_form_value(job->body, job->body_len, "velX", value, sizeof(value))) {
+        vel_x = strtod(value, NULL);
+    }
+    if (phyweb_form_value(job->body, job->body_len, "velY", value, sizeof(value))) {
+        vel_y = strtod(value, NULL);
+    }
+
+    // shots on the shared game run one at a time: the lock is held from reading the table
+    // until the result is swapped in, so every shot starts where the previous one finished
+    pthread_mutex_lock(&physerver_table_lock);
+    phylib_table *result = phyweb_shoot(physerver_table, vel_x, vel_y, &body);
+
+    // encode the shot for spectators exactly once, however many are watching
+    if (result != NULL) {
+        phyweb_buf svg = { NULL, 0, 0 };
+        job->broadcast = phyweb_event("shot", body.data, body.len);
+        if (phyweb_table_svg(&svg, result) == 0) {
+            job->latest = phyweb_event("table", svg.data, svg.len);
+        }
+        phyweb_buf_free(&svg);
+    }
+    physerver_respond(job, &body, "text/plain", result == NULL);
+    phyweb_buf_free(&body);
+
+    phylib_table *old = NULL;
+    if (result != NULL) {
+        old = physerver_table;
+        physerver_table = result;
+    }
+    physerver_hand_back(job);
+    pthread_mutex_unlock(&physerver_table_lock);
+    phylib_free_table(old);
+}
+
+/**
+ * Worker thread body: takes jobs off the pending queue and runs them.
+ *
+ * @param arg Unused.
+ * @return    NULL.
+ */
+static void *physerver_worker(void *arg) {
+
+    (void)arg;
+
+    for (;;) {
+        pthread_mutex_lock(&physerver_pending.lock);
+        while (physerver_pending.head == NULL && !physerver_stop) {
+            pthread_cond_wait(&physerver_pending.ready, &physerver_pending.lock);
+        }
+        physerver_job *job = physerver_pending.head;
+        if (job == NULL) {
+            pthread_mutex_unlock(&physerver_pending.lock);
+            return NULL;
+        }
+        physerver_pending.head = job->next;
+        if (physerver_pending.head == NULL) {
+            physerver_pending.tail = NULL;
+        }
+        pthread_mutex_unlock(&physerver_pending.lock);
+
+        physerver_run(job);
+    }
+}
+
+/**
+ * Closes a connection, keeping its memory alive while a worker still owns a job for it.
+ *
+ * @param epfd The epoll descriptor.
+ * @param conn A pointer to the connection.
+ */
+static void physerver_close(int epfd, physerver_conn *conn) {
+
+    if (conn->fd >= 0) {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, conn->fd, NULL);
+        close(conn->fd);
+        conn->fd = -1;
+    }
+    conn->closed = 1;
+
+    // unlink spectators and drop their queued references
+    if (conn->subscriber) {
+        if (conn->prev_sub != NULL) {
+            conn->prev_sub->next_sub = conn->next_sub;
+        } else {
+            physerver_subscribers = conn->next_sub;
+        }
+        if (conn->next_sub != NULL) {
+            conn->next_sub->prev_sub = conn->prev_sub;
+        }
+        while (conn->feed != NULL) {
+            physerver_feed *next = conn->feed->next;
+            phyweb_release(conn->feed->event);
+            free(conn->feed);
+            conn->feed = next;
+        }
+        conn->subscriber = 0;
+    }
+
+    if (!conn->busy) {
+        phyweb_buf_free(&conn->in);
+        phyweb_buf_free(&conn->out);
+        free(conn);
+    }
+}
+
+/**
+ * Updates the epoll interest of a connection depending on whether output is pending.
+ *
+ * @param epfd The epoll descriptor.
+ * @param conn A pointer to the connection.
+ */
+static void physerver_watch(int epfd, physerver_conn *conn) {
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    if (conn->out_pos < conn->out_len || conn->feed != NULL) {
+        ev.events |= EPOLLOUT;
+    }
+    ev.data.ptr = conn;
+    epoll_ctl(epfd, EPOLL_CTL_MOD, conn->fd, &ev);
+}
+
+/**
+ * Writes as much pending output as the socket accepts.
+ *
+ * @param conn A pointer to the connection.
+ * @return     1 if everything was written, 0 if the socket is full, or -1 on error.
+ */
+static int physerver_flush(physerver_conn *conn) {
+
+    const char *data = conn->static_out ? conn->static_out : conn->out.data;
+
+    while (conn->out_pos < conn->out_len) {
+        ssize_t sent = send(conn->fd, data + conn->out_pos, conn->out_len - conn->out_pos, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        conn->out_pos += (size_t)sent;
+    }
+
+    // response complete, reset output state for the next request
+    conn->static_out = NULL;
+    conn->out.len = 0;
+    conn->out_len = 0;
+    conn->out_pos = 0;
+
+    // then stream queued spectator events straight from the shared buffers
+    while (conn->feed != NULL) {
+        phyweb_shared *event = conn->feed->event;
+        ssize_t sent = send(conn->fd, event->data + conn->feed_pos, event->len - conn->feed_pos, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return 0;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        conn->feed_pos += (size_t)sent;
+        if (conn->feed_pos == event->len) {
+            physerver_feed *next = conn->feed->next;
+            phyweb_release(event);
+            free(conn->feed);
+            conn->feed = next;
+            conn->feed_len--;
+            conn->feed_pos = 0;
+            if (conn->feed == NULL) {
+                conn->feed_tail = NULL;
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+ * Queues a reference to a shared event on a spectator, dropping unsent events if it lags.
+ *
+ * @param conn  A pointer to the spectator connection.
+ * @param event A pointer to the shared event.
+ */
+static void physerver_enqueue(physerver_conn *conn, phyweb_shared *event) {
+
+    physerver_feed *item = (physerver_feed *)malloc(sizeof(physerver_feed));
+    if (item == NULL) {
+        return;
+    }
+    item->event = phyweb_retain(event);
+    item->next = NULL;
+
+    if (conn->feed_tail == NULL) {
+        conn->feed = item;
+    } else {
+        conn->feed_tail->next = item;
+    }
+    conn->feed_tail = item;
+    conn->feed_len++;
+
+    // backpressure: keep the event being written and the newest ones, drop the rest
+    while (conn->feed_len > PHYSERVER_MAX_FEED) {
+        physerver_feed *keep = conn->feed_pos > 0 ? conn->feed : NULL;
+        physerver_feed *victim = keep ? keep->next : conn->feed;
+        if (keep) {
+            keep->next = victim->next;
+        } else {
+            conn->feed = victim->next;
+        }
+        phyweb_release(victim->event);
+        free(victim);
+        conn->feed_len--;
+        physerver_dropped++;
+    }
+}
+
+/**
+ * Sends an event to every spectator.
+ *
+ * @param epfd  The epoll descriptor.
+ * @param event A pointer to the shared event.
+ */
+static void physerver_broadcast(int epfd, phyweb_shared *event) {
+
+    physerver_conn *conn = physerver_subscribers;
+    while (conn != NULL) {
+        physerver_conn *next = conn->next_sub;
+        int idle = conn->feed == NULL && conn->out_len == 0;
+        physerver_enqueue(conn, event);
+
+        // idle spectators are written to right away, busy ones wait for EPOLLOUT
+        if (idle) {
+            int rc = physerver_flush(conn);
+            if (rc < 0) {
+                physerver_close(epfd, conn);
+            } else if (rc == 0) {
+                physerver_watch(epfd, conn);
+            }
+        }
+        conn = next;
+    }
+}
+
+/**
+ * Finds a header value in a raw request head, case-insensitively.
+ *
+ * @param head    The request head, null terminated.
+ * @param name    The header name without the colon.
+ * @param out     The buffer receiving the trimmed value.
+ * @param out_len The size of the output buffer.
+ * @return        1 if the header was found, otherwise 0.
+ */
+static int physerver_header(const char *head, const char *name, char *out, size_t out_len) {
+
+    size_t name_len = strlen(name);
+    const char *line = strstr(head, "\r\n");
+
+    while (line != NULL && line[2] != '\r') {
+        line += 2;
+        if (strncasecmp(line, name, name_len) == 0 && line[name_len] == ':') {
+            const char *value = line + name_len + 1;
+            while (*value == ' ' || *value == '\t') {
+                value++;
+            }
+            size_t o = 0;
+            while (value[o] != '\r' && value[o] != '\0' && o + 1 < out_len) {
+                out[o] = value[o];
+                o++;
+            }
+            out[o] = '\0';
+            return 1;
+        }
+        line = strstr(line, "\r\n");
+    }
+    return 0;
+}
+
+/**
+ * Parses and dispatches one complete request from the input buffer, if there is one.
+ *
+ * @param epfd The epoll descriptor.
+ * @param conn A pointer to the connection.
+ * @return     1 if a request was handled, 0 if more input is needed, or -1 to close the connection.
+ */
+static int physerver_dispatch(int epfd, physerver_conn *conn) {
+
+    if (conn->in.len == 0) {
+        return 0;
+    }
+
+    char *end = strstr(conn->in.data, "\r\n\r\n");
+    if (end == NULL) {
+        return conn->in.len > PHYSERVER_MAX_REQUEST ? -1 : 0;
+    }
+    size_t head_len = (size_t)(end - conn->in.data) + 4;
+
+    // request line: method, path and version
+    char method[8];
+    char path[256];
+    char version[16];
+    if (sscanf(conn->in.data, "%7s %255s %15s", method, path, version) != 3) {
+        return -1;
+    }
+
+    char value[64];
+    size_t body_len = 0;
+    if (physerver_header(conn->in.data, "Content-length", value, sizeof(value))) {
+        body_len = strtoul(value, NULL, 10);
+    }
+    if (body_len > PHYSERVER_MAX_REQUEST) {
+        return -1;
+    }
+    if (conn->in.len < head_len + body_len) {
+        return 0;
+    }
+
+    // keep-alive is the default for HTTP/1.1 and opt-in for HTTP/1.0
+    int keep_alive = strcmp(version, "HTTP/1.1") == 0;
+    if (physerver_header(conn->in.data, "Connection", value, sizeof(value))) {
+        keep_alive = strcasecmp(value, "close") != 0 && (keep_alive || strcasecmp(value, "keep-alive") == 0);
+    }
+    conn->keep_alive = keep_alive;
+
+    const char *body = conn->in.data + head_len;
+    int handled = 1;
+
+    if (strcmp(method, "GET") == 0 && strcmp(path, "/index.html") == 0) {
+        conn->static_out = physerver_index.response.data;
+        conn->out_len = physerver_index.response.len;
+    } else if (strcmp(method, "GET") == 0 && strcmp(path, "/game.js") == 0) {
+        conn->static_out = physerver_script.response.data;
+        conn->out_len = physerver_script.response.len;
+    } else if (strcmp(method, "GET") == 0 && strcmp(path, "/watch") == 0) {
+        // the connection becomes a spectator and stays open
+        conn->out.len = 0;
+        if (phyweb_buf_printf(&conn->out, "HTTP/1.1 200 OK\r\nServer: physerver\r\n"
+            "Content-type: text/event-stream\r\nCache-Control: no-cache\r\nConnection: keep-alive\r\n\r\n") != 0) {
+            return -1;
+        }
+        conn->out_len = conn->out.len;
+        conn->keep_alive = 1;
+        conn->subscriber = 1;
+        conn->next_sub = physerver_subscribers;
+        if (physerver_subscribers != NULL) {
+            physerver_subscribers->prev_sub = conn;
+        }
+        physerver_subscribers = conn;
+        if (physerver_latest != NULL) {
+            physerver_enqueue(conn, physerver_latest);
+        }
+    } else if (strcmp(method, "POST") == 0 && (strcmp(path, "/start") == 0 || strcmp(path, "/shoot") == 0)) {
+        physerver_job *job = (physerver_job *)calloc(1, sizeof(physerver_job));
+        if (job == NULL) {
+            return -1;
+        }
+        job->body = (char *)malloc(body_len + 1);
+        if (job->body == NULL) {
+            free(job);
+            return -1;
+        }
+        memcpy(job->body, body, body_len);
+        job->body[body_len] = '\0';
+        job->body_len = body_len;
+        job->kind = strcmp(path, "/start") == 0 ? PHYSERVER_JOB_START : PHYSERVER_JOB_SHOOT;
+        job->conn = conn;
+        job->keep_alive = keep_alive;
+        conn->busy = 1;
+        physerver_push(&physerver_pending, job);
+    } else {
+        // unknown paths get the same 404 text as server.py
+        conn->out.len = 0;
+        phyweb_buf body404 = { NULL, 0, 0 };
+        if (phyweb_buf_printf(&body404, "404: %s not found", path) != 0
+        || physerver_headers(&conn->out, "404 Not Found", NULL, body404.len, keep_alive) != 0
+        || phyweb_buf_append(&conn->out, body404.data, body404.len) != 0) {
+            phyweb_buf_free(&body404);
+            return -1;
+        }
+        phyweb_buf_free(&body404);
+        conn->out_len = conn->out.len;
+    }
+
+    // drop the consumed request, keeping any pipelined bytes that follow it
+    size_t used = head_len + body_len;
+    memmove(conn->in.data, conn->in.data + used, conn->in.len - used + 1);
+    conn->in.len -= used;
+
+    if (!conn->busy) {
+        int rc = physerver_flush(conn);
+        if (rc < 0) {
+            return -1;
+        }
+        if (rc == 0) {
+            physerver_watch(epfd, conn);
+        }
+    }
+    return handled;
+}
+
+/**
+ * Keeps dispatching buffered requests until the connection waits on a worker or on output.
+ *
+ * @param epfd The epoll descriptor.
+ * @param conn A pointer to the connection.
+ * @return     0 if the connection is still open, or -1 if it was closed.
+ */
+static int physerver_progress(int epfd, physerver_conn *conn) {
+
+    // stop while a worker owns the connection or a response is still being written,
+    // and never read further requests from spectators
+    while (!conn->busy && conn->out_len == 0 && !conn->subscriber) {
+        int rc = physerver_dispatch(epfd, conn);
+        if (rc < 0) {
+            physerver_close(epfd, conn);
+            return -1;
+        }
+        if (rc == 0) {
+            break;
+        }
+        // a finished response on a non keep-alive connection ends it
+        if (!conn->busy && conn->out_len == 0 && !conn->keep_alive) {
+            physerver_close(epfd, conn);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Reads everything available on a connection and handles the complete requests.
+ *
+ * @param epfd The epoll descriptor.
+ * @param conn A pointer to the connection.
+ */
+static void physerver_read(int epfd, physerver_conn *conn) {
+
+    for (;;) {
+        if (phyweb_buf_reserve(&conn->in, 4096) != 0) {
+            physerver_close(epfd, conn);
+            return;
+        }
+        ssize_t got = recv(conn->fd, conn->in.data + conn->in.len, conn->in.cap - conn->in.len - 1, 0);
+        if (got > 0) {
+            conn->in.len += (size_t)got;
+            conn->in.data[conn->in.len] = '\0';
+
+            // a spectator never sends another request, so whatever it sends is dropped
+            if (conn->subscriber) {
+                conn->in.len = 0;
+                continue;
+            }
+            // room for one request with the largest head and body dispatch accepts, more
+            // than that is a client that never stops sending
+            if (conn->in.len > 2 * (size_t)PHYSERVER_MAX_REQUEST) {
+                physerver_close(epfd, conn);
+                return;
+            }
+            continue;
+        }
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        // orderly shutdown or error from the peer
+        physerver_close(epfd, conn);
+        return;
+    }
+
+    physerver_progress(epfd, conn);
+}
+
+/**
+ * Attaches finished worker responses to their connections and starts writing them.
+ *
+ * @param epfd The epoll descriptor.
+ */
+static void physerver_complete(int epfd) {
+
+    uint64_t count;
+    if (read(physerver_done_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        perror("read");
+    }
+
+    physerver_job *job = physerver_drain(&physerver_done);
+    while (job != NULL) {
+        physerver_job *next = job->next;
+        physerver_conn *conn = job->conn;
+        conn->busy = 0;
+
+        if (conn->closed) {
+            physerver_close(epfd, conn);
+        } else if (job->response.len == 0) {
+            physerver_close(epfd, conn);
+        } else {
+            // hand the response buffer over to the connection without copying
+            phyweb_buf_free(&conn->out);
+            conn->out = job->response;
+            job->response.data = NULL;
+            conn->out_len = conn->out.len;
+            conn->out_pos = 0;
+            conn->keep_alive = job->keep_alive;
+
+            int rc = physerver_flush(conn);
+            if (rc < 0 || (rc == 1 && !conn->keep_alive)) {
+                physerver_close(epfd, conn);
+            } else if (rc == 0) {
+                physerver_watch(epfd, conn);
+            } else {
+                physerver_progress(epfd, conn);
+            }
+        }
+
+        // fan the encoded shot out and remember the table for spectators joining later
+        if (job->broadcast != NULL) {
+            physerver_broadcast(epfd, job->broadcast);
+            phyweb_release(job->broadcast);
+        }
+        if (job->latest != NULL) {
+            phyweb_release(physerver_latest);
+            physerver_latest = job->latest;
+        }
+
+        free(job->body);
+        phyweb_buf_free(&job->response);
+        free(job);
+        job = next;
+    }
+}
+
+/**
+ * Accepts every pending connection on the listening socket.
+ *
+ * @param epfd     The epoll descriptor.
+ * @param listener The listening socket.
+ */
+static void physerver_accept(int epfd, int listener) {
+
+    for (;;) {
+        int fd = accept4(listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("accept4");
+            }
+            return;
+        }
+
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        physerver_conn *conn = (physerver_conn *)calloc(1, sizeof(physerver_conn));
+        if (conn == NULL) {
+            close(fd);
+            continue;
+        }
+        conn->fd = fd;
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.ptr = conn;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            close(fd);
+            free(conn);
+        }
+    }
+}
+
+/**
+ * Signal handler that asks the event loop to stop.
+ *
+ * @param sig The signal number.
+ */
+static void physerver_signal(int sig) {
+
+    (void)sig;
+    physerver_stop = 1;
+}
+
+int main(int argc, char **argv) {
+
+    int port = argc > 1 ? atoi(argv[1]) : PHYSERVER_PORT;
+    int workers = argc > 2 ? atoi(argv[2]) : PHYSERVER_WORKERS;
+    if (workers < 1) {
+        workers = 1;
+    }
+
+    // cache the static files once, with headers, so serving them is a single send
+    if (physerver_load(&physerver_index, "index.html", "text/html") != 0
+    || physerver_load(&physerver_script, "game.js", "application/javascript") != 0) {
+        fprintf(stderr, "physerver: run from the directory containing index.html and game.js\n");
+        return 1;
+    }
+
+    physerver_table = phyweb_new_rack();
+    if (physerver_table == NULL) {
+        return 1;
+    }
+
+    // spectators joining before the first shot still get a table to draw
+    phyweb_buf svg = { NULL, 0, 0 };
+    if (phyweb_table_svg(&svg, physerver_table) == 0) {
+        physerver_latest = phyweb_event("table", svg.data, svg.len);
+    }
+    phyweb_buf_free(&svg);
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, physerver_signal);
+    signal(SIGTERM, physerver_signal);
+
+    int listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int on = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((unsigned short)port);
+
+    if (listener < 0 || bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, SOMAXCONN) != 0) {
+        perror("physerver");
+        return 1;
+    }
+
+    int epfd = epoll_create1(EPOLL_CLOEXEC);
+    physerver_done_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epfd < 0 || physerver_done_fd < 0) {
+        perror("physerver");
+        return 1;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &physerver_listener_tag;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, listener, &ev);
+    ev.events = EPOLLIN;
+    ev.data.ptr = &physerver_done_tag;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, physerver_done_fd, &ev);
+
+    pthread_t *threads = (pthread_t *)calloc((size_t)workers, sizeof(pthread_t));
+    for (int i = 0; i < workers; i++) {
+        pthread_create(&threads[i], NULL, physerver_worker, NULL);
+    }
+
+    printf("Server listening on port: %d (%d workers)\n", port, workers);
+    fflush(stdout);
+
+    struct epoll_event events[PHYSERVER_MAX_EVENTS];
+    while (!physerver_stop) {
+        int completed = 0;
+        int n = epoll_wait(epfd, events, PHYSERVER_MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            void *tag = events[i].data.ptr;
+            if (tag == &physerver_listener_tag) {
+                physerver_accept(epfd, listener);
+            } else if (tag == &physerver_done_tag) {
+                completed = 1;
+            } else {
+                physerver_conn *conn = (physerver_conn *)tag;
+                if (events[i].events & EPOLLOUT) {
+                    int rc = physerver_flush(conn);
+                    if (rc < 0 || (rc == 1 && !conn->keep_alive)) {
+                        physerver_close(epfd, conn);
+                        continue;
+                    }
+                    if (rc == 1) {
+                        physerver_watch(epfd, conn);
+                        if (physerver_progress(epfd, conn) != 0) {
+                            continue;
+                        }
+                    }
+                }
+                if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                    physerver_read(epfd, conn);
+                }
+            }
+        }
+
+        // completions can free connections, so they run after this batch of events
+        if (completed) {
+            physerver_complete(epfd);
+        }
+    }
+
+    // wake and join the workers before tearing down shared state
+    pthread_mutex_lock(&physerver_pending.lock);
+    pthread_cond_broadcast(&physerver_pending.ready);
+    pthread_mutex_unlock(&physerver_pending.lock);
+    for (int i = 0; i < workers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+
+    // backpressure is otherwise invisible, so say how much of it there was
+    printf("Server stopped: %lu spectator events dropped\n", physerver_dropped);
+
+    while (physerver_subscribers != NULL) {
+        physerver_close(epfd, physerver_subscribers);
+    }
+    phyweb_release(physerver_latest);
+
+    close(listener);
+    close(physerver_done_fd);
+    close(epfd);
+    phylib_free_table(physerver_table);
+    phyweb_buf_free(&physerver_index.response);
+    phyweb_buf_free(&physerver_script.response);
+    return 0;
+}
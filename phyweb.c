@@ -0,0 +1,499 @@
+/**
+ * @file phyweb.c
+ * @brief C file containing the rendering and game helpers shared by the native server tools.
+ *
+ * These functions produce the same SVG markup and shot frames that Physics.py generates,
+ * so the native server can answer /start and /shoot without going through Python.
+ */
+
+#include <stdarg.h>
+
+#include "phyweb.h"
+
+static const char *phyweb_header =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n"
+    "<!DOCTYPE svg PUBLIC \"-//W3C//DTD SVG 1.1//EN\"\n"
+    "\"http://www.w3.org/Graphics/SVG/1.1/DTD/svg11.dtd\">\n"
+    "<svg width=\"700\" height=\"1375\" viewBox=\"-25 -25 1400 2750\"\n"
+    "xmlns=\"http://www.w3.org/2000/svg\"\n"
+    "xmlns:xlink=\"http://www.w3.org/1999/xlink\">\n"
+    "<rect width=\"1350\" height=\"2700\" x=\"0\" y=\"0\" fill=\"#C0D0C0\" />";
+
+static const char *phyweb_footer = "</svg>\n";
+
+static const char *phyweb_colours[] = {
+    "WHITE", "YELLOW", "BLUE", "RED", "PURPLE", "ORANGE", "GREEN", "BROWN",
+    "BLACK", "LIGHTYELLOW", "LIGHTBLUE", "PINK", "MEDIUMPURPLE", "LIGHTSALMON",
+    "LIGHTGREEN", "SANDYBROWN"
+};
+
+/**
+ * Makes sure the buffer has room for extra bytes plus a terminating null.
+ *
+ * @param buf   A pointer to the buffer.
+ * @param extra The number of bytes about to be appended.
+ * @return      0 on success, or -1 if memory allocation fails.
+ */
+int phyweb_buf_reserve(phyweb_buf *buf, size_t extra) {
+
+    // nothing to do if there is already enough room
+    if (buf->len + extra + 1 <= buf->cap) {
+        return 0;
+    }
+
+    // grow geometrically so repeated appends stay linear
+    size_t cap = buf->cap ? buf->cap : 256;
+    while (cap < buf->len + extra + 1) {
+        cap *= 2;
+    }
+
+    char *data = (char *)realloc(buf->data, cap);
+    if (data == NULL) {
+        return -1;
+    }
+
+    buf->data = data;
+    buf->cap = cap;
+    return 0;
+}
+
+/**
+ * Appends raw bytes to the buffer.
+ *
+ * @param buf  A pointer to the buffer.
+ * @param data The bytes to append.
+ * @param len  The number of bytes to append.
+ * @return     0 on success, or -1 if memory allocation fails.
+ */
+int phyweb_buf_append(phyweb_buf *buf, const char *data, size_t len) {
+
+    if (phyweb_buf_reserve(buf, len) != 0) {
+        return -1;
+    }
+
+    memcpy(buf->data + buf->len, data, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+    return 0;
+}
+
+/**
+ * Appends printf style formatted text to the buffer.
+ *
+ * @param buf A pointer to the buffer.
+ * @param fmt The format string.
+ * @return    0 on success, or -1 if formatting or memory allocation fails.
+ */
+int phyweb_buf_printf(phyweb_buf *buf, const char *fmt, ...) {
+
+    va_list args;
+
+    // measure first, then format straight into the buffer
+    va_start(args, fmt);
+    int needed = vsnprintf(NULL, 0, fmt, args);
+    va_end(args);
+
+    if (needed < 0 || phyweb_buf_reserve(buf, (size_t)needed) != 0) {
+        return -1;
+    }
+
+    va_start(args, fmt);
+    vsnprintf(buf->data + buf->len, (size_t)needed + 1, fmt, args);
+    va_end(args);
+
+    buf->len += (size_t)needed;
+    return 0;
+}
+
+/**
+ * Frees the memory held by the buffer and resets it to empty.
+ *
+ * @param buf A pointer to the buffer.
+ */
+void phyweb_buf_free(phyweb_buf *buf) {
+
+    free(buf->data);
+    buf->data = NULL;
+    buf->len = 0;
+    buf->cap = 0;
+}
+
+/**
+ * Encodes a server-sent event into a new reference-counted buffer.
+ *
+ * The data is sent as a single data line, so newlines in it are replaced by spaces; SVG does
+ * not depend on them. The buffer starts with one reference owned by the caller. Reference
+ * counts are not atomic, so a buffer must only be shared by one thread at a time.
+ *
+ * @param event The event name.
+ * @param data  The event data.
+ * @param len   The length of the data.
+ * @return      A pointer to the new buffer, or NULL if memory allocation fails.
+ */
+phyweb_shared *phyweb_event(const char *event, const char *data, size_t len) {
+
+    size_t head = strlen("event: ") + strlen(event) + strlen("\ndata: ");
+    phyweb_shared *shared = (phyweb_shared *)malloc(sizeof(phyweb_shared) + head + len + 3);
+    if (shared == NULL) {
+        return NULL;
+    }
+
+    char *out = shared->data;
+    out += sprintf(out, "event: %s\ndata: ", event);
+    for (size_t i = 0; i < len; i++) {
+        *out++ = data[i] == '\n' || data[i] == '\r' ? ' ' : data[i];
+    }
+    *out++ = '\n';
+    *out++ = '\n';
+    *out = '\0';
+
+    shared->refs = 1;
+    shared->len = (size_t)(out - shared->data);
+    return shared;
+}
+
+/**
+ * Adds a reference to a shared buffer.
+ *
+ * @param shared A pointer to the buffer.
+ * @return       The same pointer, for convenience.
+ */
+phyweb_shared *phyweb_retain(phyweb_shared *shared) {
+
+    shared->refs++;
+    return shared;
+}
+
+/**
+ * Drops a reference to a shared buffer, freeing it with the last one.
+ *
+ * @param shared A pointer to the buffer, may be NULL.
+ */
+void phyweb_release(phyweb_shared *shared) {
+
+    if (shared != NULL && --shared->refs == 0) {
+        free(shared);
+    }
+}
+
+/**
+ * Appends the SVG markup of a single object, matching the svg() methods in Physics.py.
+ *
+ * @param buf    A pointer to the buffer.
+ * @param object A pointer to the object, may be NULL.
+ * @return       0 on success, or -1 if memory allocation fails.
+ */
+static int phyweb_object_svg(phyweb_buf *buf, phylib_object *object) {
+
+    if (object == NULL) {
+        return 0;
+    }
+
+    switch (object->type) {
+        case PHYLIB_STILL_BALL:
+            return phyweb_buf_printf(buf, " <circle cx=\"%d\" cy=\"%d\" r=\"%d\" fill=\"%s\" />\n",
+                (int)object->obj.still_ball.pos.x,
+                (int)object->obj.still_ball.pos.y,
+                (int)PHYLIB_BALL_RADIUS,
+                phyweb_colours[object->obj.still_ball.number % 16]);
+        case PHYLIB_ROLLING_BALL:
+            return phyweb_buf_printf(buf, " <circle cx=\"%d\" cy=\"%d\" r=\"%d\" fill=\"%s\" />\n",
+                (int)object->obj.rolling_ball.pos.x,
+                (int)object->obj.rolling_ball.pos.y,
+                (int)PHYLIB_BALL_RADIUS,
+                phyweb_colours[object->obj.rolling_ball.number % 16]);
+        case PHYLIB_HOLE:
+            return phyweb_buf_printf(buf, " <circle cx=\"%d\" cy=\"%d\" r=\"%d\" fill=\"black\" />\n",
+                (int)object->obj.hole.pos.x,
+                (int)object->obj.hole.pos.y,
+                (int)PHYLIB_HOLE_RADIUS);
+        case PHYLIB_HCUSHION:
+            return phyweb_buf_printf(buf, " <rect width=\"1400\" height=\"25\" x=\"-25\" y=\"%d\" fill=\"darkgreen\" />\n",
+                object->obj.hcushion.y == 0.0 ? -25 : (int)PHYLIB_TABLE_LENGTH);
+        case PHYLIB_VCUSHION:
+            return phyweb_buf_printf(buf, " <rect width=\"25\" height=\"2750\" x=\"%d\" y=\"-25\" fill=\"darkgreen\" />\n",
+                object->obj.vcushion.x == 0.0 ? -25 : (int)PHYLIB_TABLE_WIDTH);
+    }
+    return 0;
+}
+
+/**
+ * Appends the SVG document for a whole table.
+ *
+ * @param buf   A pointer to the buffer.
+ * @param table A pointer to the table to render.
+ * @return      0 on success, or -1 if memory allocation fails.
+ */
+int phyweb_table_svg(phyweb_buf *buf, phylib_table *table) {
+
+    if (phyweb_buf_append(buf, phyweb_header, strlen(phyweb_header)) != 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < PHYLIB_MAX_OBJECTS; i++) {
+        if (phyweb_object_svg(buf, table->object[i]) != 0) {
+            return -1;
+        }
+    }
+
+    return phyweb_buf_append(buf, phyweb_footer, strlen(phyweb_footer));
+}
+
+/**
+ * Appends the SVG of a table rolled forward by a time offset without allocating a new table.
+ *
+ * @param buf    A pointer to the buffer.
+ * @param table  A pointer to the table at the start of the segment.
+ * @param offset The time since the start of the segment.
+ * @return       0 on success, or -1 if memory allocation fails.
+ */
+static int phyweb_rolled_svg(phyweb_buf *buf, phylib_table *table, double offset) {
+
+    if (phyweb_buf_append(buf, phyweb_header, strlen(phyweb_header)) != 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < PHYLIB_MAX_OBJECTS; i++) {
+        phylib_object *object = table->object[i];
+
+        // rolling balls are moved on a stack copy, everything else is drawn as is
+        phylib_object rolled;
+        if (object != NULL && object->type == PHYLIB_ROLLING_BALL) {
+            rolled = *object;
+            phylib_roll(&rolled, object, offset);
+            object = &rolled;
+        }
+        if (phyweb_object_svg(buf, object) != 0) {
+            return -1;
+        }
+    }
+
+    return phyweb_buf_append(buf, phyweb_footer, strlen(phyweb_footer));
+}
+
+/**
+ * Creates the opening table used by server.py: a three ball triangle and the cue ball.
+ *
+ * @return A pointer to the new table, or NULL if memory allocation fails.
+ */
+phylib_table *phyweb_new_rack(void) {
+
+    phylib_table *table = phylib_new_table();
+    if (table == NULL) {
+        return NULL;
+    }
+
+    // same small random nudge the python server applies to the rack
+    double nudge[4];
+    for (int i = 0; i < 4; i++) {
+        nudge[i] = ((double)rand() / RAND_MAX) * 3.0 - 1.5;
+    }
+
+    double spacing = PHYLIB_BALL_DIAMETER + 4.0;
+    phylib_coord one = { PHYLIB_TABLE_WIDTH / 2.0, PHYLIB_TABLE_WIDTH / 2.0 };
+    phylib_coord two = { PHYLIB_TABLE_WIDTH / 2.0 - spacing / 2.0 + nudge[0],
+                         PHYLIB_TABLE_WIDTH / 2.0 - sqrt(3.0) / 2.0 * spacing + nudge[1] };
+    phylib_coord three = { PHYLIB_TABLE_WIDTH / 2.0 + spacing / 2.0 + nudge[2],
+                           PHYLIB_TABLE_WIDTH / 2.0 - sqrt(3.0) / 2.0 * spacing + nudge[3] };
+    phylib_coord cue = { PHYLIB_TABLE_WIDTH / 2.0, PHYLIB_TABLE_LENGTH - PHYLIB_TABLE_WIDTH / 2.0 };
+
+    phylib_add_object(table, phylib_new_still_ball(1, &one));
+    phylib_add_object(table, phylib_new_still_ball(2, &two));
+    phylib_add_object(table, phylib_new_still_ball(3, &three));
+    phylib_add_object(table, phylib_new_still_ball(0, &cue));
+
+    return table;
+}
+
+/**
+ * Shoots the cue ball and renders every animation frame, like Game.shoot in Physics.py.
+ *
+ * Frames are written as a comma separated list with a leading and trailing comma,
+ * which is the format game.js splits and animates.
+ *
+ * @param table  A pointer to the table before the shot, it is not modified.
+ * @param vel_x  The x velocity given to the cue ball.
+ * @param vel_y  The y velocity given to the cue ball.
+ * @param frames A pointer to the buffer receiving the frames, may be NULL to skip rendering.
+ * @return       A pointer to the table after all balls stopped, or NULL if memory allocation fails.
+ */
+phylib_table *phyweb_shoot(phylib_table *table, double vel_x, double vel_y, phyweb_buf *frames) {
+
+    phylib_table *current = phylib_copy_table(table);
+    if (current == NULL) {
+        return NULL;
+    }
+
+    // every shot starts on a fresh clock, phylib stops advancing a table at PHYLIB_MAX_TIME
+    current->time = 0.0;
+
+    // set the cue ball rolling
+    phylib_coord vel = { vel_x, vel_y };
+    phylib_strike(current, 0, &vel);
+
+    if (frames != NULL && phyweb_buf_append(frames, ",", 1) != 0) {
+        phylib_free_table(current);
+        return NULL;
+    }
+
+    // step through segments, rendering every frame inside each one
+    phylib_table *next;
+    while ((next = phylib_segment(current)) != NULL) {
+        if (frames != NULL) {
+            int count = (int)((next->time - current->time) / PHYWEB_FRAME_INTERVAL);
+            for (int f = 0; f < count; f++) {
+                if (phyweb_rolled_svg(frames, current, f * PHYWEB_FRAME_INTERVAL) != 0
+                || phyweb_buf_append(frames, ",", 1) != 0) {
+                    phylib_free_table(current);
+                    phylib_free_table(next);
+                    return NULL;
+                }
+            }
+        }
+        phylib_free_table(current);
+        current = next;
+    }
+
+    // respot the cue ball if it was pocketed
+    int has_cue = 0;
+    for (int i = 10; i < PHYLIB_MAX_OBJECTS; i++) {
+        if (current->object[i] != NULL && current->object[i]->obj.still_ball.number == 0) {
+            has_cue = 1;
+        }
+    }
+    if (!has_cue) {
+        phylib_coord cue = { PHYLIB_TABLE_WIDTH / 2.0, PHYLIB_TABLE_LENGTH - PHYLIB_TABLE_WIDTH / 2.0 };
+        phylib_add_object(current, phylib_new_still_ball(0, &cue));
+    }
+
+    // the final resting table is always the last frame
+    if (frames != NULL && (phyweb_table_svg(frames, current) != 0 || phyweb_buf_append(frames, ",", 1) != 0)) {
+        phylib_free_table(current);
+        return NULL;
+    }
+
+    return current;
+}
+
+/**
+ * Returns the value of a hexadecimal digit, or -1 if it is not one.
+ *
+ * @param c The character.
+ * @return  The digit value, or -1.
+ */
+static int phyweb_hex(char c) {
+
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+/**
+ * Looks up and url-decodes a field in an application/x-www-form-urlencoded body.
+ *
+ * @param body    The request body, not necessarily null terminated.
+ * @param len     The length of the body.
+ * @param key     The field name to look for.
+ * @param out     The buffer receiving the decoded value.
+ * @param out_len The size of the output buffer.
+ * @return        1 if the field was found, otherwise 0.
+ */
+int phyweb_form_value(const char *body, size_t len, const char *key, char *out, size_t out_len) {
+
+    size_t key_len = strlen(key);
+    size_t pos = 0;
+
+    while (pos < len) {
+        // find the end of this key=value pair
+        size_t end = pos;
+        while (end < len && body[end] != '&') {
+            end++;
+        }
+
+        if (end - pos > key_len && memcmp(body + pos, key, key_len) == 0 && body[pos + key_len] == '=') {
+            size_t o = 0;
+            for (size_t i = pos + key_len + 1; i < end && o + 1 < out_len; i++) {
+                if (body[i] == '+') {
+                    out[o++] = ' ';
+                } else if (body[i] == '%' && i + 2 < end && phyweb_hex(body[i + 1]) >= 0 && phyweb_hex(body[i + 2]) >= 0) {
+                    out[o++] = (char)(phyweb_hex(body[i + 1]) * 16 + phyweb_hex(body[i + 2]));
+                    i += 2;
+                } else {
+                    out[o++] = body[i];
+                }
+            }
+            out[o] = '\0';
+            return 1;
+        }
+        pos = end + 1;
+    }
+
+    if (out_len > 0) {
+        out[0] = '\0';
+    }
+    return 0;
+}
+
+/**
+ * Appends text with the html special characters escaped.
+ *
+ * @param buf  A pointer to the buffer.
+ * @param text The null terminated text.
+ * @return     0 on success, or -1 if memory allocation fails.
+ */
+static int phyweb_escaped(phyweb_buf *buf, const char *text) {
+
+    for (; *text; text++) {
+        int rc;
+        switch (*text) {
+            case '<': rc = phyweb_buf_append(buf, "&lt;", 4); break;
+            case '>': rc = phyweb_buf_append(buf, "&gt;", 4); break;
+            case '&': rc = phyweb_buf_append(buf, "&amp;", 5); break;
+            case '"': rc = phyweb_buf_append(buf, "&quot;", 6); break;
+            default: rc = phyweb_buf_append(buf, text, 1); break;
+        }
+        if (rc != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Builds the game page returned by /start.
+ *
+ * @param buf     A pointer to the buffer.
+ * @param table   A pointer to the opening table.
+ * @param player1 The name of the first player.
+ * @param player2 The name of the second player.
+ * @return        0 on success, or -1 if memory allocation fails.
+ */
+int phyweb_start_page(phyweb_buf *buf, phylib_table *table, const char *player1, const char *player2) {
+
+    if (phyweb_buf_printf(buf,
+        "\n            <html>\n"
+        "                <head>\n"
+        "                    <script src=\"https://ajax.googleapis.com/ajax/libs/jquery/3.6.3/jquery.min.js\"></script>\n"
+        "                    <script src=\"game.js\"></script>\n"
+        "                    <title> Pool Simulator </title>\n"
+        "                </head>\n"
+        "                <body>\n"
+        "                    <div id=\"table\">\n"
+        "                        ") != 0
+    || phyweb_table_svg(buf, table) != 0
+    || phyweb_buf_printf(buf, "\n                    </div>\n                    <h1>Player 1: ") != 0
+    || phyweb_escaped(buf, player1) != 0
+    || phyweb_buf_printf(buf, " </h1>\n                    <h1>Player 2: ") != 0
+    || phyweb_escaped(buf, player2) != 0
+    || phyweb_buf_printf(buf, " </h1>\n                </body>\n            </html>\n            ") != 0) {
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,53 @@
+/**
+ * @file phyweb.h
+ * @brief Header file for the rendering and game helpers shared by the native server tools.
+ *
+ * This header declares a growable byte buffer, the SVG renderer for tables and the
+ * racking / shooting helpers that mirror what server.py and Physics.py do in Python.
+ */
+
+#ifndef PHYWEB_H
+#define PHYWEB_H
+
+#include "phylib.h"
+
+#define PHYWEB_FRAME_INTERVAL (0.01) // s
+#define PHYWEB_MAX_NAME (64)
+
+typedef struct {
+char *data;
+size_t len;
+size_t cap;
+} phyweb_buf;
+
+typedef struct {
+int refs;
+size_t len;
+char data[];
+} phyweb_shared;
+
+int phyweb_buf_reserve( phyweb_buf *buf, size_t extra );
+
+int phyweb_buf_append( phyweb_buf *buf, const char *data, size_t len );
+
+int phyweb_buf_printf( phyweb_buf *buf, const char *fmt, ... );
+
+void phyweb_buf_free( phyweb_buf *buf );
+
+phyweb_shared *phyweb_event( const char *event, const char *data, size_t len );
+
+phyweb_shared *phyweb_retain( phyweb_shared *shared );
+
+void phyweb_release( phyweb_shared *shared );
+
+int phyweb_table_svg( phyweb_buf *buf, phylib_table *table );
+
+phylib_table *phyweb_new_rack( void );
+
+phylib_table *phyweb_shoot( phylib_table *table, double vel_x, double vel_y, phyweb_buf *frames );
+
+int phyweb_form_value( const char *body, size_t len, const char *key, char *out, size_t out_len );
+
+int phyweb_start_page( phyweb_buf *buf, phylib_table *table, const char *player1, const char *player2 );
+
+#endif